@@ -3,11 +3,14 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/lapic.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/fixed_point.h";
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -18,66 +21,170 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/* Number of timer ticks since OS booted. */
+/* 8254 input frequency, and the counter value that makes
+   channel 0 fire TIMER_FREQ times per second (rounded). */
+#define PIT_HZ 1193180
+#define PIT_TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Length of the window, in 8254 counts, that the TSC and the local
+   APIC timer are measured over on channel 2 (10 ms). */
+#define PIT_CALIBRATE_COUNT (PIT_HZ / 100)
+
+#define NS_PER_SEC 1000000000
+#define NS_PER_TICK (NS_PER_SEC / TIMER_FREQ)
+
+/* Number of timer ticks since OS booted.  Written only by the
+   bootstrap processor, with interrupts off; ticks_seq lets the
+   other CPUs read it, and the dynamic-tick state below, without
+   disabling interrupts. */
 static int64_t ticks;
+static struct seqlock ticks_seq = SEQLOCK_INITIALIZER;
+
+/* If true, the periodic tick is stopped while the idle thread
+   runs.  Controlled by kernel command-line option "-nohz". */
+bool timer_nohz;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
-static unsigned loops_per_tick;
+/* If true, each CPU's local APIC timer drives the tick instead of
+   the 8254, and device interrupts go through the I/O APIC.
+   Controlled by kernel command-line option "-apic"; cleared by
+   timer_apic_init() if the hardware is missing. */
+bool timer_apic;
 
-static intr_handler_func timer_interrupt;
-static bool too_many_loops (unsigned loops);
-static void busy_wait (int64_t loops);
-static void real_time_sleep (int64_t num, int32_t denom);
+/* Local APIC timer counts per timer tick.  Measured against the
+   8254 by timer_apic_init(). */
+static uint32_t lapic_tick_count;
+
+/* Dynamic-tick state.  While nohz_active, channel 0 is in one-shot
+   mode and will fire once, nohz_ticks tick boundaries from when it
+   was armed.  nohz_first is the count left in the tick that was in
+   progress at that time, nohz_count the total count programmed. */
+static bool nohz_active;
+static int64_t nohz_ticks;
+static unsigned nohz_first;
+static unsigned nohz_count;
+
+/* Time-stamp counter rate, measured by timer_calibrate().
+   timer_ns() converts TSC cycles since tsc_base to nanoseconds as
+   (cycles * tsc_ns_mult) >> 32, a multiply instead of a divide. */
+static uint64_t tsc_hz;
+static uint64_t tsc_ns_mult;
+static uint64_t tsc_base;
+
+static intr_handler_func timer_interrupt, lapic_timer_interrupt;
+static void pit_set_periodic (void);
+static void pit2_start (unsigned count);
+static void pit2_wait (void);
+static unsigned pit_read (bool *expired);
+static int64_t nohz_elapsed (bool *expired);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
    corresponding interrupt. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb (0x40, count & 0xff);
-	outb (0x40, count >> 8);
-
+	pit_set_periodic ();
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Measures the rate of the time-stamp counter, used by timer_ns()
+   and for brief delays, by counting TSC cycles while 8254 channel
+   2 counts down PIT_CALIBRATE_COUNT.  Channel 2 needs no
+   interrupts, so this takes a single 10 ms window. */
 void
 timer_calibrate (void) {
-	unsigned high_bit, test_bit;
+	enum intr_level old_level;
+	uint64_t start, cycles;
 
-	ASSERT (intr_get_level () == INTR_ON);
 	printf ("Calibrating timer...  ");
 
-	/* Approximate loops_per_tick as the largest power-of-two
-	   still less than one timer tick. */
-	loops_per_tick = 1u << 10;
-	while (!too_many_loops (loops_per_tick << 1)) {
-		loops_per_tick <<= 1;
-		ASSERT (loops_per_tick != 0);
+	old_level = intr_disable ();
+	pit2_start (PIT_CALIBRATE_COUNT);
+	start = rdtsc ();
+	pit2_wait ();
+	cycles = rdtsc () - start;
+	intr_set_level (old_level);
+
+	tsc_hz = cycles * PIT_HZ / PIT_CALIBRATE_COUNT;
+	ASSERT (tsc_hz != 0);
+	tsc_ns_mult = ((uint64_t) NS_PER_SEC << 32) / tsc_hz;
+	tsc_base = start;
+
+	printf ("%'"PRIu64" TSC cycles/s.\n", tsc_hz);
+}
+
+/* If "-apic" was given, moves the tick from the 8254 to the local
+   APIC timer and device interrupts from the PICs to the I/O APIC.
+   The local APIC timer runs at the bus clock, whose rate we have
+   to measure: we let it count down while 8254 channel 2 does, as
+   in timer_calibrate().  Falls back to the 8254 and PICs if the
+   hardware is missing.  Must be called with interrupts on. */
+void
+timer_apic_init (void) {
+	enum intr_level old_level;
+	uint32_t count;
+
+	ASSERT (intr_get_level () == INTR_ON);
+	if (!timer_apic)
+		return;
+	if (timer_nohz) {
+		printf ("timer: -nohz needs the 8254, not using the APIC.\n");
+		timer_apic = false;
+		return;
+	}
+	if (!lapic_init ()) {
+		printf ("timer: no local APIC, using the 8254.\n");
+		timer_apic = false;
+		return;
 	}
 
-	/* Refine the next 8 bits of loops_per_tick. */
-	high_bit = loops_per_tick;
-	for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-		if (!too_many_loops (high_bit | test_bit))
-			loops_per_tick |= test_bit;
+	old_level = intr_disable ();
+	pit2_start (PIT_CALIBRATE_COUNT);
+	lapic_timer_start (UINT32_MAX, LAPIC_TIMER_MASKED);
+	pit2_wait ();
+	count = (uint64_t) (UINT32_MAX - lapic_timer_count ())
+		* PIT_TICK_COUNT / PIT_CALIBRATE_COUNT;
+
+	if (count == 0 || !intr_use_apic ()) {
+		lapic_timer_stop ();
+		intr_set_level (old_level);
+		printf ("timer: no I/O APIC, using the 8254.\n");
+		timer_apic = false;
+		return;
+	}
+	intr_register_lapic (LAPIC_TIMER_VEC, lapic_timer_interrupt, "APIC Timer");
+	lapic_tick_count = count;
+	lapic_timer_start (lapic_tick_count, LAPIC_TIMER_PERIODIC);
+	intr_set_level (old_level);
+
+	printf ("timer: local APIC timer, %'"PRIu32" counts/tick.\n", count);
+}
 
-	printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+/* Starts the tick on a secondary CPU, if the local APIC timer
+   drives it.  Otherwise the bootstrap processor forwards its
+   ticks.  Called with interrupts off. */
+void
+timer_init_ap (void) {
+	if (timer_apic)
+		lapic_timer_start (lapic_tick_count, LAPIC_TIMER_PERIODIC);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) {
-	enum intr_level old_level = intr_disable ();
-	int64_t t = ticks;
-	intr_set_level (old_level);
-	barrier ();
+	unsigned seq;
+	int64_t t;
+
+	do {
+		seq = seqlock_read_begin (&ticks_seq);
+		t = ticks;
+		if (nohz_active) {
+			/* Keep our own timer interrupt from reading the 8254
+			   between our port accesses. */
+			enum intr_level old_level = intr_disable ();
+			t += nohz_elapsed (NULL);
+			intr_set_level (old_level);
+		}
+	} while (seqlock_read_retry (&ticks_seq, seq));
 	return t;
 }
 
@@ -88,6 +195,16 @@ timer_elapsed (int64_t then) {
 	return timer_ticks () - then;
 }
 
+/* Returns the number of nanoseconds since timer_calibrate(), read
+   from the time-stamp counter.  Monotonic and far finer than
+   timer_ticks(), and may be called with interrupts off or from an
+   interrupt handler.  Assumes the TSCs of all CPUs run in step. */
+int64_t
+timer_ns (void) {
+	uint64_t cycles = rdtsc () - tsc_base;
+	return ((unsigned __int128) cycles * tsc_ns_mult) >> 32;
+}
+
 // Challenge -> 'start' 변수가 invalid 할 수 있다. 이럴 땐 어떻게 고치냐? (아직은 생각하지말라함)
 /* Suspends execution for approximately TICKS timer ticks. */
 void
@@ -103,19 +220,31 @@ timer_sleep (int64_t ticks) {
 /* Suspends execution for approximately MS milliseconds. */
 void
 timer_msleep (int64_t ms) {
-	real_time_sleep (ms, 1000);
+	timer_nsleep (ms * 1000 * 1000);
 }
 
 /* Suspends execution for approximately US microseconds. */
 void
 timer_usleep (int64_t us) {
-	real_time_sleep (us, 1000 * 1000);
+	timer_nsleep (us * 1000);
 }
 
-/* Suspends execution for approximately NS nanoseconds. */
+/* Suspends execution for approximately NS nanoseconds.
+
+   Whole ticks are slept on the sleep queue, so the CPU is free for
+   other threads or to halt.  timer_sleep() counts from the start of
+   the current tick, so N ticks never end more than N * NS_PER_TICK
+   from now; once less than a tick is left, the rest is timed with
+   timer_ns() in a spin rather than rounded up to a tick boundary. */
 void
 timer_nsleep (int64_t ns) {
-	real_time_sleep (ns, 1000 * 1000 * 1000);
+	int64_t deadline = timer_ns () + ns;
+
+	ASSERT (intr_get_level () == INTR_ON);
+	while ((ns = deadline - timer_ns ()) >= NS_PER_TICK)
+		timer_sleep (ns / NS_PER_TICK);
+	while (deadline - timer_ns () > 0)
+		asm volatile ("pause");
 }
 
 /* Prints timer statistics. */
@@ -124,18 +253,98 @@ timer_print_stats (void) {
 	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  If dynamic ticks are enabled, stops the periodic tick
+   and arms channel 0 to fire once at the tick boundary of the
+   next sleep deadline (or as close as the 16-bit counter allows),
+   so an idle machine is not woken TIMER_FREQ times a second.
+
+   Not used with -mlfqs, whose load average must be sampled on
+   every second boundary. */
+void
+timer_idle_enter (void) {
+	int64_t delta;
+	unsigned first;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (!timer_nohz || thread_mlfqs || nohz_active)
+		return;
+
+	delta = get_global_ticks () - ticks;
+	if (delta <= 1)
+		return;
+
+	/* Keep the phase of the current tick: fire after what is left
+	   of it plus whole ticks, limited by the counter width. */
+	first = pit_read (NULL);
+	if (first == 0 || first > PIT_TICK_COUNT)
+		return;
+	if (delta > 1 + (0xffff - first) / PIT_TICK_COUNT)
+		delta = 1 + (0xffff - first) / PIT_TICK_COUNT;
+	if (delta <= 1)
+		return;
+
+	seqlock_write_begin (&ticks_seq);
+	nohz_first = first;
+	nohz_ticks = delta;
+	nohz_count = first + (delta - 1) * PIT_TICK_COUNT;
+	nohz_active = true;
+	seqlock_write_end (&ticks_seq);
+
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb (0x40, nohz_count & 0xff);
+	outb (0x40, nohz_count >> 8);
+}
+
+/* Called from the scheduler, with interrupts off, when the idle
+   thread is switched out.  Accounts for the tick boundaries that
+   passed without an interrupt and restarts the periodic tick. */
+void
+timer_idle_exit (void) {
+	bool expired;
+	int64_t elapsed;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (!nohz_active)
+		return;
+
+	elapsed = nohz_elapsed (&expired);
+	/* If the one-shot already fired, its interrupt is pending and
+	   will count the final tick itself. */
+	seqlock_write_begin (&ticks_seq);
+	ticks += expired ? nohz_ticks - 1 : elapsed;
+	nohz_active = false;
+	seqlock_write_end (&ticks_seq);
+	pit_set_periodic ();
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
+	seqlock_write_begin (&ticks_seq);
+	if (nohz_active) {
+		bool expired;
+		nohz_elapsed (&expired);
+		/* A periodic tick that was already pending when the one-shot
+		   was armed counts as an ordinary tick. */
+		if (expired) {
+			ticks += nohz_ticks - 1;
+			nohz_active = false;
+			pit_set_periodic ();
+		}
+	}
 	ticks++; 
+	seqlock_write_end (&ticks_seq);
 	thread_tick ();
+	if (!timer_apic)
+		smp_send_tick ();
 	if (thread_mlfqs) {
 		incr_recent_cpu(); 	          // In every clock tick, increase the running thread’s recent_cpu by one.
-		if (timer_ticks() % 4 == 0) { // In every fourth tick, recompute the priority of all threads
-			calc_all_priority();
+		if (timer_ticks() % 4 == 0) { // In every fourth tick, recompute the priority of the running thread
+			calc_priority(thread_current ());
 		}
 		if (timer_ticks() % TIMER_FREQ == 0) {		
-			calc_all_recent_cpu();    // In every second, update every thread’s recent_cpu
+			calc_all_recent_cpu();    // In every second, start a new recent_cpu decay epoch
 			calc_load_avg();
 		}
 	}
@@ -145,59 +354,73 @@ timer_interrupt (struct intr_frame *args UNUSED) {
 	}
 }
 
-/* Returns true if LOOPS iterations waits for more than one timer
-   tick, otherwise false. */
-static bool
-too_many_loops (unsigned loops) {
-	/* Wait for a timer tick. */
-	int64_t start = ticks;
-	while (ticks == start)
-		barrier ();
+/* Local APIC timer interrupt handler.  Each CPU gets its own
+   tick; the bootstrap processor's also advances global time. */
+static void
+lapic_timer_interrupt (struct intr_frame *args) {
+	if (cpu_current ()->id == 0)
+		timer_interrupt (args);
+	else
+		thread_tick ();
+}
+
+/* Programs channel 0 to interrupt TIMER_FREQ times per second. */
+static void
+pit_set_periodic (void) {
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb (0x40, PIT_TICK_COUNT & 0xff);
+	outb (0x40, PIT_TICK_COUNT >> 8);
+}
 
-	/* Run LOOPS loops. */
-	start = ticks;
-	busy_wait (loops);
+/* Starts channel 2 counting down COUNT, in mode 0, with the
+   speaker disconnected.  Its OUT pin, which pit2_wait() polls
+   through port 0x61, goes high when the count reaches zero. */
+static void
+pit2_start (unsigned count) {
+	outb (0x61, (inb (0x61) & ~0x02) | 0x01);   /* Gate on, speaker off. */
+	outb (0x43, 0xb0);    /* CW: counter 2, LSB then MSB, mode 0, binary. */
+	outb (0x42, count & 0xff);
+	outb (0x42, count >> 8);
+}
 
-	/* If the tick count changed, we iterated too long. */
-	barrier ();
-	return start != ticks;
+/* Waits for channel 2 to finish the count set by pit2_start(). */
+static void
+pit2_wait (void) {
+	while ((inb (0x61) & 0x20) == 0)
+		continue;
 }
 
-/* Iterates through a simple loop LOOPS times, for implementing
-   brief delays.
+/* Latches and returns the current count of channel 0.  If EXPIRED
+   is non-null, also reports the OUT pin, which in mode 0 goes
+   high once the count has reached zero. */
+static unsigned
+pit_read (bool *expired) {
+	uint8_t status, lo, hi;
 
-   Marked NO_INLINE because code alignment can significantly
-   affect timings, so that if this function was inlined
-   differently in different places the results would be difficult
-   to predict. */
-static void NO_INLINE
-busy_wait (int64_t loops) {
-	while (loops-- > 0)
-		barrier ();
+	outb (0x43, 0xc2);    /* Read-back: latch count and status, counter 0. */
+	status = inb (0x40);
+	lo = inb (0x40);
+	hi = inb (0x40);
+	if (expired != NULL)
+		*expired = (status & 0x80) != 0;
+	return lo | (hi << 8);
 }
 
-/* Sleep for approximately NUM/DENOM seconds. */
-static void
-real_time_sleep (int64_t num, int32_t denom) {
-	/* Convert NUM/DENOM seconds into timer ticks, rounding down.
+/* Returns the number of tick boundaries that have passed since the
+   one-shot was armed, and whether it has fired. */
+static int64_t
+nohz_elapsed (bool *expired_) {
+	bool expired;
+	unsigned count = pit_read (&expired);
+	unsigned passed;
 
-	   (NUM / DENOM) s
-	   ---------------------- = NUM * TIMER_FREQ / DENOM ticks.
-	   1 s / TIMER_FREQ ticks
-	   */
-	int64_t ticks = num * TIMER_FREQ / denom;
+	if (expired_ != NULL)
+		*expired_ = expired;
+	if (expired)
+		return nohz_ticks;
 
-	ASSERT (intr_get_level () == INTR_ON);
-	if (ticks > 0) {
-		/* We're waiting for at least one full timer tick.  Use
-		   timer_sleep() because it will yield the CPU to other
-		   processes. */
-		timer_sleep (ticks);
-	} else {
-		/* Otherwise, use a busy-wait loop for more accurate
-		   sub-tick timing.  We scale the numerator and denominator
-		   down by 1000 to avoid the possibility of overflow. */
-		ASSERT (denom % 1000 == 0);
-		busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000));
-	}
-}
\ No newline at end of file
+	passed = nohz_count - count;
+	if (passed < nohz_first)
+		return 0;
+	return 1 + (passed - nohz_first) / PIT_TICK_COUNT;
+}
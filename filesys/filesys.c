@@ -7,10 +7,16 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "devices/disk.h"
+#include "threads/synch.h"
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
 
+/* Guards the directory tree.  Lookups read-hold it, so that
+ * concurrent opens of different files proceed in parallel;
+ * creating or removing a file write-holds it. */
+static struct rwlock dir_tree_lock;
+
 static void do_format (void);
 
 /* Initializes the file system module.
@@ -22,6 +28,8 @@ filesys_init (bool format) {
 		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
 	inode_init ();
+	file_init ();
+	rwlock_init (&dir_tree_lock);
 
 #ifdef EFILESYS
 	fat_init ();
@@ -60,14 +68,19 @@ filesys_done (void) {
 bool
 filesys_create (const char *name, off_t initial_size) {
 	disk_sector_t inode_sector = 0;
-	struct dir *dir = dir_open_root ();
-	bool success = (dir != NULL
+	struct dir *dir;
+	bool success;
+
+	rwlock_acquire_write (&dir_tree_lock);
+	dir = dir_open_root ();
+	success = (dir != NULL
 			&& free_map_allocate (1, &inode_sector)
 			&& inode_create (inode_sector, initial_size)
 			&& dir_add (dir, name, inode_sector));
 	if (!success && inode_sector != 0)
 		free_map_release (inode_sector, 1);
 	dir_close (dir);
+	rwlock_release_write (&dir_tree_lock);
 
 	return success;
 }
@@ -79,12 +92,15 @@ filesys_create (const char *name, off_t initial_size) {
  * or if an internal memory allocation fails. */
 struct file *
 filesys_open (const char *name) {
-	struct dir *dir = dir_open_root ();
+	struct dir *dir;
 	struct inode *inode = NULL;
 
+	rwlock_acquire_read (&dir_tree_lock);
+	dir = dir_open_root ();
 	if (dir != NULL)
 		dir_lookup (dir, name, &inode);
 	dir_close (dir);
+	rwlock_release_read (&dir_tree_lock);
 
 	return file_open (inode);
 }
@@ -95,9 +111,14 @@ filesys_open (const char *name) {
  * or if an internal memory allocation fails. */
 bool
 filesys_remove (const char *name) {
-	struct dir *dir = dir_open_root ();
-	bool success = dir != NULL && dir_remove (dir, name);
+	struct dir *dir;
+	bool success;
+
+	rwlock_acquire_write (&dir_tree_lock);
+	dir = dir_open_root ();
+	success = dir != NULL && dir_remove (dir, name);
 	dir_close (dir);
+	rwlock_release_write (&dir_tree_lock);
 
 	return success;
 }
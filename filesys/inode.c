@@ -6,6 +6,8 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -30,7 +32,7 @@ bytes_to_sectors (off_t size) {
 struct inode {
 	struct list_elem elem;              /* Element in inode list. */
 	disk_sector_t sector;               /* Sector number of disk location. */
-	int open_cnt;                       /* Number of openers. */
+	int open_cnt;                       /* Number of openers (atomic). */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
 	struct inode_disk data;             /* Inode content. */
@@ -50,13 +52,28 @@ byte_to_sector (const struct inode *inode, off_t pos) {
 }
 
 /* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
+ * returns the same `struct inode'.
+ *
+ * open_inodes_lock is read-held to search the list, so opens of
+ * inodes that are already open do not serialize; they bump
+ * open_cnt atomically.  Adding an inode takes it for writing, and
+ * so does inode_close(), so that open_cnt never drops to zero
+ * while a reader could still find the inode. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* In-memory inodes.  At some 550 bytes, they would take 1 kB
+ * blocks from malloc(). */
+static struct kmem_cache inode_cache;
+
+static struct inode *find_open_inode (disk_sector_t);
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	rwlock_init (&open_inodes_lock);
+	kmem_cache_init (&inode_cache, "inode", sizeof (struct inode), NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -101,39 +118,60 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
-	struct inode *inode;
+	struct inode *inode, *other;
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
-	}
+	rwlock_acquire_read (&open_inodes_lock);
+	inode = find_open_inode (sector);
+	rwlock_release_read (&open_inodes_lock);
+	if (inode != NULL)
+		return inode;
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
+	inode = kmem_cache_alloc (&inode_cache);
 	if (inode == NULL)
 		return NULL;
 
 	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
 	inode->sector = sector;
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
 	disk_read (filesys_disk, inode->sector, &inode->data);
+
+	/* Someone else may have opened it while we were reading. */
+	rwlock_acquire_write (&open_inodes_lock);
+	other = find_open_inode (sector);
+	if (other == NULL)
+		list_push_front (&open_inodes, &inode->elem);
+	rwlock_release_write (&open_inodes_lock);
+	if (other != NULL) {
+		kmem_cache_free (&inode_cache, inode);
+		return other;
+	}
 	return inode;
 }
 
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+ * if there is none.  open_inodes_lock must be held. */
+static struct inode *
+find_open_inode (disk_sector_t sector) {
+	struct list_elem *e;
+
+	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+			e = list_next (e)) {
+		struct inode *inode = list_entry (e, struct inode, elem);
+		if (inode->sector == sector)
+			return inode_reopen (inode);
+	}
+	return NULL;
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
 	if (inode != NULL)
-		inode->open_cnt++;
+		__atomic_add_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED);
 	return inode;
 }
 
@@ -148,15 +186,30 @@ inode_get_inumber (const struct inode *inode) {
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
+	int cnt;
+	bool last;
+
 	/* Ignore null pointer. */
 	if (inode == NULL)
 		return;
 
-	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
+	/* While other openers remain, just drop our count, without
+	 * holding up lookups. */
+	cnt = __atomic_load_n (&inode->open_cnt, __ATOMIC_RELAXED);
+	while (cnt > 1)
+		if (__atomic_compare_exchange_n (&inode->open_cnt, &cnt, cnt - 1,
+					false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return;
+
+	/* We may be the last opener.  Only a lookup, which the lock
+	 * excludes, could reopen INODE now, so the count is final. */
+	rwlock_acquire_write (&open_inodes_lock);
+	last = __atomic_sub_fetch (&inode->open_cnt, 1, __ATOMIC_RELAXED) == 0;
+	if (last)
 		list_remove (&inode->elem);
+	rwlock_release_write (&open_inodes_lock);
 
+	if (last) {
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
 			free_map_release (inode->sector, 1);
@@ -164,7 +217,7 @@ inode_close (struct inode *inode) {
 					bytes_to_sectors (inode->data.length)); 
 		}
 
-		free (inode); 
+		kmem_cache_free (&inode_cache, inode);
 	}
 }
 
@@ -7,17 +7,31 @@
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+#include <stdbool.h>
+
+/* Stop the periodic tick while idle?  Set by "-nohz". */
+extern bool timer_nohz;
+
+/* Use the local APIC timer and the I/O APIC?  Set by "-apic". */
+extern bool timer_apic;
+
 void timer_init (void);
 void timer_calibrate (void);
+void timer_apic_init (void);
+void timer_init_ap (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -0,0 +1,65 @@
+#ifndef __LIB_KERNEL_PLIST_H
+#define __LIB_KERNEL_PLIST_H
+
+/* Priority-sorted list.
+ *
+ * A wait queue that always yields its highest-priority element
+ * first, and among elements of equal priority the one that was
+ * inserted first.  Like our lists and heaps it does not require
+ * dynamic allocation: each structure that can be in a plist
+ * embeds a struct plist_elem member, and the plist_entry macro
+ * converts a struct plist_elem back to its enclosing structure.
+ *
+ * Elements are kept on one list sorted by priority, so that the
+ * elements of each priority form a FIFO "bucket".  The first
+ * element of each bucket is also on a second, much shorter list
+ * of bucket heads, which is what insertion walks to find its
+ * bucket.
+ *
+ * Costs: plist_front(), plist_pop_front() and plist_remove() are
+ * O(1); plist_insert() and plist_requeue() are O(k) in the number
+ * k of distinct priorities present, independent of the number of
+ * elements. */
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Plist element. */
+struct plist_elem {
+	struct list_elem node;      /* In the list of all elements. */
+	struct list_elem head;      /* In the list of bucket heads, if first
+	                               of its priority; otherwise unlinked. */
+	int priority;               /* Priority it is filed under. */
+};
+
+/* Converts pointer to plist element PLIST_ELEM into a pointer to
+   the structure that PLIST_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the plist element. */
+#define plist_entry(PLIST_ELEM, STRUCT, MEMBER)           \
+	((STRUCT *) ((uint8_t *) &(PLIST_ELEM)->node      \
+		- offsetof (STRUCT, MEMBER.node)))
+
+/* Plist. */
+struct plist {
+	struct list nodes;          /* All elements, highest priority first. */
+	struct list heads;          /* First element of each priority. */
+};
+
+void plist_init (struct plist *);
+
+void plist_insert (struct plist *, struct plist_elem *, int priority);
+void plist_remove (struct plist *, struct plist_elem *);
+void plist_requeue (struct plist *, struct plist_elem *, int priority);
+struct plist_elem *plist_front (struct plist *);
+struct plist_elem *plist_pop_front (struct plist *);
+
+struct plist_elem *plist_begin (struct plist *);
+struct plist_elem *plist_next (struct plist *, struct plist_elem *);
+
+bool plist_queued (const struct plist_elem *);
+bool plist_empty (struct plist *);
+
+#endif /* lib/kernel/plist.h */
@@ -0,0 +1,72 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+ *
+ * A balanced binary search tree that, like our lists, hash tables
+ * and heaps, does not require dynamic allocation.  Each structure
+ * that can be in a tree embeds a struct rbtree_elem member, and
+ * the rbtree_entry macro converts a struct rbtree_elem back to its
+ * enclosing structure.  See lib/kernel/list.h for a detailed
+ * explanation of the technique.
+ *
+ * Costs: rbtree_insert(), rbtree_remove(), rbtree_find() and
+ * rbtree_floor() are O(log n) worst case.  Unlike a hash table,
+ * the tree keeps its elements in order, so rbtree_floor() can find
+ * the element just below a key that is not in the tree, and
+ * rbtree_min()/rbtree_next() walk the elements in order.
+ *
+ * Lookups take a key in the form of an element, as hash_find()
+ * does: fill in the key members of a dummy structure and pass a
+ * pointer to its rbtree_elem. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct rbtree_elem {
+	struct rbtree_elem *parent; /* Parent, or null at the root. */
+	struct rbtree_elem *left;   /* Lesser elements. */
+	struct rbtree_elem *right;  /* Greater elements. */
+	bool red;                   /* Red or black? */
+};
+
+/* Converts pointer to tree element RBTREE_ELEM into a pointer to
+   the structure that RBTREE_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the tree element. */
+#define rbtree_entry(RBTREE_ELEM, STRUCT, MEMBER)         \
+	((STRUCT *) ((uint8_t *) &(RBTREE_ELEM)->parent   \
+		- offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rbtree_less_func (const struct rbtree_elem *a,
+		const struct rbtree_elem *b, void *aux);
+
+/* Red-black tree. */
+struct rbtree {
+	struct rbtree_elem *root;   /* Root, or null if empty. */
+	size_t elem_cnt;            /* Number of elements in tree. */
+	rbtree_less_func *less;     /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+void rbtree_init (struct rbtree *, rbtree_less_func *, void *aux);
+
+struct rbtree_elem *rbtree_insert (struct rbtree *, struct rbtree_elem *);
+void rbtree_remove (struct rbtree *, struct rbtree_elem *);
+struct rbtree_elem *rbtree_find (const struct rbtree *,
+		const struct rbtree_elem *);
+struct rbtree_elem *rbtree_floor (const struct rbtree *,
+		const struct rbtree_elem *);
+
+struct rbtree_elem *rbtree_min (const struct rbtree *);
+struct rbtree_elem *rbtree_next (const struct rbtree_elem *);
+
+size_t rbtree_size (const struct rbtree *);
+bool rbtree_empty (const struct rbtree *);
+
+#endif /* lib/kernel/rbtree.h */
@@ -36,6 +36,16 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Scheduling. */
+	SYS_SCHED_SETAFFINITY,      /* Restrict a process to some CPUs. */
+
+	/* Synchronization. */
+	SYS_FUTEX_WAIT,             /* Sleep on a word in memory. */
+	SYS_FUTEX_WAKE,             /* Wake sleepers on a word in memory. */
+
+	/* Debugging. */
+	SYS_LOCKSTAT,               /* Print kernel lock statistics. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -50,6 +50,18 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Scheduling. */
+int sched_setaffinity (pid_t, unsigned mask);
+
+/* Synchronization. */
+#define FUTEX_MISMATCH (-1)     /* futex_wait(): *ADDR was not EXPECTED. */
+#define FUTEX_TIMEDOUT (-2)     /* futex_wait(): TIMEOUT_MS expired. */
+int futex_wait (unsigned *addr, unsigned expected, long long timeout_ms);
+int futex_wake (unsigned *addr, int n);
+
+/* Debugging. */
+int lockstat (bool reset);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
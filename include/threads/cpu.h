@@ -0,0 +1,89 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include "threads/loader.h"
+
+/* Maximum number of CPUs we can run on. */
+#define CPU_MAX 8
+
+/* Physical address the secondary CPUs start executing at.  It
+   must be page aligned and below 1 MB; the startup IPI can only
+   name a real-mode page. */
+#define AP_TRAMPOLINE 0x8000
+
+/* Offsets into struct cpu used by assembly code, relative to
+   the %gs base. */
+#define CPU_SCRATCH0 8
+#define CPU_SCRATCH1 16
+#define CPU_TSS 24
+
+#ifndef __ASSEMBLER__
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Per-CPU state.
+ *
+ * Each CPU's %gs base points to its own struct cpu, so
+ * cpu_current() is a single load.  While a CPU runs user code
+ * the kernel's value is parked in MSR_KERNEL_GS_BASE, and every
+ * entry into and exit from the kernel executes `swapgs' (see
+ * intr-stubs.S, syscall-entry.S and do_iret()).
+ *
+ * A thread may move to another CPU whenever it can be preempted,
+ * so the result of cpu_current() is only meaningful while
+ * interrupts are off. */
+struct cpu {
+	struct cpu *self;           /* This structure, at %gs:0. */
+	uint64_t scratch[2];        /* Spill slots for syscall_entry. */
+	struct task_state *tss;     /* This CPU's TSS (userprog only). */
+
+	int id;                     /* Index in cpus[]. */
+	uint8_t apic_id;            /* Local APIC ID. */
+	volatile bool started;      /* Set by the CPU once it is up. */
+
+	/* Owned by thread.c. */
+	struct thread *idle_thread; /* Runs when the run queue is empty. */
+	struct thread *curr;        /* Running thread. */
+	unsigned thread_ticks;      /* # of timer ticks since last yield. */
+	unsigned balance_ticks;     /* # of timer ticks since last balancing. */
+	struct list destruction_req;/* Dying threads to free. */
+	long long idle_ticks;       /* # of timer ticks spent idle. */
+	long long kernel_ticks;     /* # of timer ticks in kernel threads. */
+	long long user_ticks;       /* # of timer ticks in user programs. */
+
+	/* Owned by interrupt.c. */
+	bool in_external_intr;      /* Processing an external interrupt? */
+	bool yield_on_return;       /* Yield on interrupt return? */
+
+	/* Owned by userprog/gdt.c. */
+	uint64_t gdt[SEL_CNT];      /* This CPU's GDT. */
+};
+
+_Static_assert (offsetof (struct cpu, scratch) == CPU_SCRATCH0,
+		"CPU_SCRATCH0 is out of date");
+_Static_assert (offsetof (struct cpu, tss) == CPU_TSS,
+		"CPU_TSS is out of date");
+
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+extern int smp_ncpu;
+
+/* Returns the running CPU's struct cpu. */
+static inline struct cpu *
+cpu_current (void) {
+	struct cpu *c;
+	asm volatile ("movq %%gs:0, %0" : "=r" (c));
+	return c;
+}
+
+void cpu_init (void);
+void smp_init (void);
+void smp_send_tick (void);
+void smp_send_resched (struct cpu *);
+void smp_flush_tlb (void);
+void smp_call (void (*func) (void *aux), void *aux);
+#endif /* __ASSEMBLER__ */
+
+#endif /* threads/cpu.h */
@@ -0,0 +1,11 @@
+#ifndef THREADS_IOAPIC_H
+#define THREADS_IOAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool ioapic_init (void);
+void ioapic_route (int irq, uint8_t vec, uint8_t apic_id);
+void ioapic_mask (int irq);
+
+#endif /* threads/ioapic.h */
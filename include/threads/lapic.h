@@ -0,0 +1,31 @@
+#ifndef THREADS_LAPIC_H
+#define THREADS_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Vector the local APIC raises for spurious interrupts. */
+#define LAPIC_SPURIOUS_VEC 0xff
+
+/* Vector the local APIC timer raises. */
+#define LAPIC_TIMER_VEC 0xfe
+
+/* Local APIC timer modes, for lapic_timer_start(). */
+enum lapic_timer_mode {
+	LAPIC_TIMER_ONESHOT,        /* Interrupt once. */
+	LAPIC_TIMER_PERIODIC,       /* Interrupt every COUNT counts. */
+	LAPIC_TIMER_MASKED          /* Count down once, silently. */
+};
+
+bool lapic_init (void);
+void lapic_init_ap (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+void lapic_send_ipi_others (uint8_t vec);
+void lapic_start_ap (uint8_t apic_id, uint64_t entry);
+void lapic_timer_start (uint32_t count, enum lapic_timer_mode);
+void lapic_timer_stop (void);
+uint32_t lapic_timer_count (void);
+
+#endif /* threads/lapic.h */
@@ -0,0 +1,56 @@
+#ifndef THREADS_LOCKSTAT_H
+#define THREADS_LOCKSTAT_H
+
+/* Lock contention statistics.
+
+   Compiled in only if LOCKSTAT is defined, e.g. by adding
+   -DLOCKSTAT to DEFINES in a project's Make.vars; otherwise none
+   of this exists and locks and mutexes carry no extra fields.
+
+   Locks and mutexes are counted by class: all those initialized
+   under the same name, or, if unnamed, at the same call site,
+   share one struct lockstat. */
+
+#ifdef LOCKSTAT
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+
+/* Number of call sites recorded per class that had to wait. */
+#define LOCKSTAT_SITES 8
+
+/* One place locks of a class were waited for from. */
+struct lockstat_site {
+	void *site;                 /* Return address of the acquire. */
+	uint64_t cnt;               /* Number of waits. */
+	uint64_t wait_ns;           /* Total time waited. */
+};
+
+/* Statistics for one class of locks.  Updated atomically, without
+   a lock, from any CPU. */
+struct lockstat {
+	const char *name;           /* Class name, or null. */
+	void *init_site;            /* Where an unnamed class was initialized. */
+	uint64_t acquired;          /* Number of acquisitions. */
+	uint64_t contended;         /* Acquisitions that had to wait. */
+	uint64_t wait_ns;           /* Total time waited. */
+	uint64_t wait_max_ns;       /* Longest wait. */
+	uint64_t hold_ns;           /* Total time held. */
+	uint64_t hold_max_ns;       /* Longest hold. */
+	struct lockstat_site sites[LOCKSTAT_SITES];
+};
+
+/* Current time for lockstat_acquired()'s START. */
+#define lockstat_now() ((uint64_t) timer_ns ())
+
+struct lockstat *lockstat_register (const char *name, void *init_site);
+uint64_t lockstat_acquired (struct lockstat *, uint64_t start, bool contended,
+		void *site);
+void lockstat_released (struct lockstat *, uint64_t acquired_at);
+void lockstat_print (void);
+void lockstat_reset (void);
+
+#endif /* LOCKSTAT */
+
+#endif /* threads/lockstat.h */
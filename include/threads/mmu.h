@@ -19,6 +19,10 @@ bool pml4_is_dirty (uint64_t *pml4, const void *upage);
 void pml4_set_dirty (uint64_t *pml4, const void *upage, bool dirty);
 bool pml4_is_accessed (uint64_t *pml4, const void *upage);
 void pml4_set_accessed (uint64_t *pml4, const void *upage, bool accessed);
+void *mmio_map (uint64_t pa);
+bool kern_set_page (void *kva, void *kpage);
+void *kern_get_page (const void *kva);
+void *kern_clear_page (void *kva);
 
 #define is_writable(pte) (*(pte) & PTE_W)
 #define is_user_pte(pte) (*(pte) & PTE_U)
@@ -0,0 +1,58 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/cpu.h"
+#include "threads/spinlock.h"
+
+/* Slab allocator.
+
+   A kmem_cache hands out objects of one fixed size, carved out of
+   single pages called slabs, with no rounding beyond word
+   alignment.  Each CPU keeps a small magazine of free objects in
+   front of the cache, so most allocations and frees touch neither
+   the cache's lock nor another CPU's cache lines. */
+
+#define KMEM_MAG_SIZE 16                /* Magazine capacity. */
+
+/* One CPU's magazine for one cache. */
+struct kmem_magazine {
+	size_t cnt;                     /* Number of objects in objs[]. */
+	void *objs[KMEM_MAG_SIZE];      /* Free objects, hottest last. */
+	uint64_t allocs, frees;         /* Objects handed out and taken back. */
+	uint64_t refills, flushes;      /* Trips to the slabs. */
+};
+
+/* An object cache. */
+struct kmem_cache {
+	const char *name;               /* For statistics. */
+	size_t size;                    /* Object size, rounded for alignment. */
+	void (*ctor) (void *);          /* Object constructor, or null. */
+	size_t obj_cnt;                 /* Objects per slab. */
+	size_t obj_ofs;                 /* Offset of the first object. */
+	size_t color_cnt;               /* Distinct slab colors. */
+	struct list_elem elem;          /* In the list of all caches. */
+
+	struct spinlock lock;           /* Protects the members below. */
+	size_t color_next;              /* Color of the next new slab. */
+	struct list partial;            /* Slabs with free and used objects. */
+	struct list full;               /* Slabs with no free objects. */
+	struct list empty;              /* Slabs with no used objects. */
+	size_t slab_cnt;                /* Number of slabs. */
+	size_t slab_peak;               /* Largest slab_cnt seen. */
+
+	struct kmem_magazine mags[CPU_MAX]; /* Per-CPU magazines. */
+};
+
+void kmem_cache_init (struct kmem_cache *, const char *name, size_t size,
+		void (*ctor) (void *));
+void *kmem_cache_alloc (struct kmem_cache *);
+void *kmem_cache_zalloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+struct kmem_cache *kmem_cache_of (const void *);
+size_t kmem_cache_size (const struct kmem_cache *);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -0,0 +1,36 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+
+/* Spin lock.
+ *
+ * Protects data shared between CPUs over short critical sections
+ * that must not sleep: the run queues, the sleep heap and the
+ * wait lists inside semaphores.  Disabling interrupts only keeps
+ * the local CPU out, so a spin lock must be taken with interrupts
+ * already off, which also means an interrupt handler can never
+ * spin on a lock its own CPU holds:
+ *
+ *    old_level = intr_disable ();
+ *    spinlock_acquire (&l);
+ *    ...
+ *    spinlock_release (&l);
+ *    intr_set_level (old_level);
+ *
+ * Use struct lock (synch.h) for anything that may sleep. */
+struct spinlock {
+	volatile int locked;        /* Nonzero while held. */
+	int cpu;                    /* Holding CPU's id, or -1 (for debugging). */
+};
+
+/* Initializer for a statically allocated, unlocked spin lock. */
+#define SPINLOCK_INITIALIZER { 0, -1 }
+
+void spinlock_init (struct spinlock *);
+void spinlock_acquire (struct spinlock *);
+bool spinlock_try_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *);
+bool spinlock_held_by_current_cpu (const struct spinlock *);
+
+#endif /* threads/spinlock.h */
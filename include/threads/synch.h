@@ -2,16 +2,18 @@
 #define THREADS_SYNCH_H
 
 #include <list.h>
+#include <plist.h>
 #include <stdbool.h>
+#include "threads/lockstat.h"
+#include "threads/spinlock.h"
 
 /* A counting semaphore. */
 struct semaphore {
 	unsigned value;             /* Current value. */
-	struct list waiters;        /* List of waiting threads. */
+	struct plist waiters;       /* Waiting threads, by priority. */
+	struct spinlock lock;       /* Protects value and waiters. */
 };
 bool cmp_thread_priority(const struct list_elem *a_, const struct list_elem *b_, void *aux);
-bool cmp_priority_by_sema(const struct list_elem *a_, const struct list_elem *b_, void *aux);
-bool cmp_priority_by_donation_elem(const struct list_elem *a_, const struct list_elem *b_, void *aux);
 void donation();
 void update_donate();
 void sema_init (struct semaphore *, unsigned value);
@@ -24,17 +26,104 @@ void sema_self_test (void);
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	struct plist_elem elem;     /* In holder's held_locks. */
+	bool filed;                 /* On holder's held_locks? */
+#ifdef LOCKSTAT
+	struct lockstat *stat;      /* Statistics for this lock's class. */
+	uint64_t acquired_at;       /* When the holder got it. */
+#endif
 };
 
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Adaptive mutex.  Like a lock, but a thread that finds it held
+   spins instead of sleeping for as long as the holder is running
+   on another CPU, which for a short critical section is sooner
+   than a context switch.  Holders receive no priority donation,
+   so keep the critical sections short. */
+struct mutex {
+	struct thread *holder;      /* Thread holding mutex, or null. */
+	unsigned waiter_cnt;        /* Number of threads in waiters. */
+	struct plist waiters;       /* Sleeping threads, by priority. */
+	struct spinlock lock;       /* Protects waiters. */
+#ifdef LOCKSTAT
+	struct lockstat *stat;      /* Statistics for this mutex's class. */
+	uint64_t acquired_at;       /* When the holder got it. */
+#endif
+};
+
+void mutex_init (struct mutex *);
+void mutex_init_named (struct mutex *, const char *name);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+bool mutex_held_by_current_thread (const struct mutex *);
+
+/* Reader-writer lock.  Held either by any number of readers or
+   by a single writer.  Writers are preferred: once a writer is
+   waiting, new readers wait behind it.  Every waiter's priority is
+   inherited by every holder, readers included. */
+struct rwlock {
+	struct thread *writer;      /* Thread holding it for writing, or null. */
+	struct list readers;        /* struct rwlock_hold of each reader. */
+	struct plist read_waiters;  /* Waiting readers, by priority. */
+	struct plist write_waiters; /* Waiting writers, by priority. */
+	struct plist_elem elem;     /* In writer's held_locks. */
+	bool filed;                 /* On writer's held_locks? */
+	struct spinlock lock;       /* Protects the members above. */
+};
+
+/* A reader's hold on an rwlock.  Each thread has RWLOCK_HOLD_MAX
+   of them, so it may read that many rwlocks at once. */
+struct rwlock_hold {
+	struct rwlock *rwlock;      /* Rwlock read, or null if unused. */
+	struct thread *thread;      /* Reader. */
+	struct list_elem elem;      /* In rwlock's readers. */
+	struct plist_elem held_elem;/* In reader's held_locks. */
+	bool filed;                 /* On reader's held_locks? */
+};
+#define RWLOCK_HOLD_MAX 4
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
+/* Sequence lock, for small read-mostly data that readers copy
+   out.  Readers never wait for each other or stall writers; they
+   retry if a write overlapped their read:
+
+	do {
+		seq = seqlock_read_begin (&sl);
+		... copy the data ...
+	} while (seqlock_read_retry (&sl, seq));
+
+   Writers exclude one another with a spinlock, so they must run
+   with interrupts off and must not sleep. */
+struct seqlock {
+	unsigned seq;               /* Odd while a write is in progress. */
+	struct spinlock lock;       /* Serializes writers. */
+};
+
+#define SEQLOCK_INITIALIZER { 0, SPINLOCK_INITIALIZER }
+
+void seqlock_init (struct seqlock *);
+unsigned seqlock_read_begin (const struct seqlock *);
+bool seqlock_read_retry (const struct seqlock *, unsigned seq);
+void seqlock_write_begin (struct seqlock *);
+void seqlock_write_end (struct seqlock *);
+
 /* Condition variable. */
 struct condition {
-	struct list waiters;        /* List of waiting threads. */
+	struct plist waiters;       /* Waiting threads, by priority. */
+	struct spinlock lock;       /* Protects waiters. */
 };
 
 void cond_init (struct condition *);
@@ -2,10 +2,13 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
+#include <plist.h>
 #include <stdint.h>
 #include "threads/interrupt.h"
 #include "threads/fixed_point.h"
+#include "threads/synch.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -83,29 +86,39 @@ typedef int tid_t;
  * the `magic' member of the running thread's `struct thread' is
  * set to THREAD_MAGIC.  Stack overflow will normally change this
  * value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
- * the run queue (thread.c), or it can be an element in a
- * semaphore wait list (synch.c).  It can be used these two ways
- * only because they are mutually exclusive: only a thread in the
- * ready state is on the run queue, whereas only a thread in the
- * blocked state is on a semaphore wait list. */
+/* The `elem' member is the thread's element in its CPU's run
+ * queue (thread.c).  A blocked thread is instead on a semaphore's
+ * wait queue (synch.c), or a mutex's or rwlock's, through
+ * `wait_elem', which keeps the priority the thread is filed under. */
 struct thread {
 	/* Owned by thread.c. */
 	tid_t tid;                          /* Thread identifier. */
 	enum thread_status status;          /* Thread state. */
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
+	int cpu;                            /* CPU whose run queue we are on. */
+	unsigned affinity;                  /* CPUs we may run on, bit N for CPU N. */
+	bool wake_pending;                  /* Unblocked before we blocked. */
 
-	int64_t local_ticks;
+	int64_t local_ticks;                /* Tick to wake up at, if sleeping. */
+	struct heap_elem sleep_elem;        /* Sleep heap element. */
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem;              /* List element. */
-	struct list donation_list;
-	struct list_elem donation_elem;
-	int original_priority;
-	struct lock *wait_on_lock;
+	struct plist_elem wait_elem;        /* Semaphore wait queue element. */
+	struct semaphore *wait_sema;        /* Semaphore we are queued on. */
+	int lock_cnt;                       /* Number of locks held. */
+	struct plist held_locks;            /* Locks held, by top waiter priority. */
+	int original_priority;              /* Priority before inheritance. */
+	struct lock *wait_on_lock;          /* Lock we are waiting for. */
+	struct rwlock *wait_on_rwlock;      /* Rwlock we are waiting for. */
+	bool wait_rw_write;                 /* Waiting for it to write. */
+	struct condition *wait_cond;        /* Condition we are queued on. */
+	struct plist_elem *wait_cond_elem;  /* Our entry in its queue. */
+	struct rwlock_hold rw_holds[RWLOCK_HOLD_MAX]; /* Rwlocks being read. */
 
 	int nice;
 	int recent_cpu;
+	unsigned recent_cpu_epoch;          /* Last MLFQS epoch applied to recent_cpu. */
 	struct list_elem allelem;
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
@@ -126,8 +139,12 @@ struct thread {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+struct cpu;
+
 void thread_init (void);
 void thread_start (void);
+struct thread *thread_prepare_ap (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
 
 void thread_tick (void);
 void thread_print_stats (void);
@@ -147,6 +164,8 @@ void thread_yield (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_change_priority (struct thread *, int priority);
+bool thread_set_affinity (unsigned mask);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -155,13 +174,22 @@ int thread_get_load_avg (void);
 
 void do_iret (struct intr_frame *tf);
 int64_t get_global_ticks(void);
-void set_global_ticks();
+void set_global_ticks(void);
 void thread_wakeup(int64_t ticks);
 void thread_sleep(int64_t howLong);
-bool ticks_less(const struct list_elem *a_, const struct list_elem *b_,
+void thread_sleep_prepare (int64_t wake_tick);
+bool thread_sleep_cancel (struct thread *);
+bool ticks_less(const struct heap_elem *a_, const struct heap_elem *b_,
             void *aux UNUSED);
 void preempt(void);
 bool cmp_thread_priority(const struct list_elem *a_, const struct list_elem *b_,
             void *aux UNUSED);
 void update_donate();
+
+/* MLFQS bookkeeping, driven by the timer interrupt. */
+void incr_recent_cpu (void);
+void calc_priority (struct thread *);
+void calc_recent_cpu (struct thread *);
+void calc_all_recent_cpu (void);
+void calc_load_avg (void);
 #endif /* threads/thread.h */
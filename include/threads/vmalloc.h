@@ -0,0 +1,32 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Virtually contiguous kernel allocations.
+
+   vmalloc() builds a large buffer out of single pages from the
+   kernel pool, wherever they are, and maps them at consecutive
+   addresses in a region of kernel virtual memory set aside for
+   the purpose.  Unlike a multi-page malloc(), it does not fail
+   just because no run of free pages is long enough.
+
+   The memory is only virtually contiguous, so vtop() does not
+   work on it. */
+
+#define VMALLOC_BASE 0xc000000000       /* Start of the region. */
+#define VMALLOC_PAGES 16384             /* Size of the region, 64 MB. */
+#define VMALLOC_END (VMALLOC_BASE + (uint64_t) VMALLOC_PAGES * 4096)
+
+/* True if VADDR lies in the vmalloc() region. */
+#define is_vmalloc_vaddr(vaddr) \
+	((uint64_t) (vaddr) >= VMALLOC_BASE && (uint64_t) (vaddr) < VMALLOC_END)
+
+void vmalloc_init (void);
+void *vmalloc (size_t) __attribute__ ((malloc));
+void *vcalloc (size_t, size_t) __attribute__ ((malloc));
+void vfree (void *);
+
+#endif /* threads/vmalloc.h */
@@ -0,0 +1,14 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include <stdint.h>
+
+/* futex_wait() results besides 0 for a wake-up. */
+#define FUTEX_MISMATCH (-1)     /* Value was not as expected, or bad address. */
+#define FUTEX_TIMEDOUT (-2)     /* Timeout expired first. */
+
+void futex_init (void);
+int futex_wait (uint32_t *uaddr, uint32_t expected, int64_t timeout_ms);
+int futex_wake (uint32_t *uaddr, int n);
+
+#endif /* userprog/futex.h */
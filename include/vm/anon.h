@@ -1,13 +1,41 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <stdint.h>
 #include "vm/vm.h"
 struct page;
 enum vm_type;
 
+/* No swap slot. */
+#define SWAP_NONE SIZE_MAX
+
+/* Most pages evicted together in one sequential write. */
+#define SWAP_CLUSTER 8
+
+/* Most pages read ahead of a swap-in. */
+#define SWAP_READAHEAD 7
+
 struct anon_page {
+	size_t slot;            /* Swap slot holding a copy, or SWAP_NONE. */
+	bool readahead;         /* Read ahead and not touched since? */
+};
+
+/* Swap statistics. */
+struct swap_stats {
+	size_t slot_cnt;                /* Slots on the swap disk. */
+	size_t used_cnt;                /* Slots holding a page. */
+	uint64_t writes;                /* Pages written. */
+	uint64_t clusters;              /* Batches they were written in. */
+	uint64_t reads;                 /* Pages read for faults. */
+	uint64_t readaheads;            /* Pages read ahead of faults. */
+	uint64_t readahead_hits;        /* Read ahead, then touched. */
+	uint64_t readahead_misses;      /* Read ahead, then dropped untouched. */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+bool anon_swap_out_cluster (struct page *pages[], size_t cnt);
+bool anon_swap_copy (struct page *src, void *kva);
+void anon_readahead_hit (struct page *page);
+void swap_get_stats (struct swap_stats *);
 
 #endif
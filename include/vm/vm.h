@@ -1,7 +1,9 @@
 #ifndef VM_VM_H
 #define VM_VM_H
+#include <list.h>
 #include <stdbool.h>
 #include "threads/palloc.h"
+#include "threads/synch.h"
 
 enum vm_type {
 	/* page not initialized */
@@ -27,6 +29,7 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/vma.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -46,6 +49,7 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	bool writable;         /* May user code write to it? */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -59,10 +63,30 @@ struct page {
 	};
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".  There is one for each page of
+ * the user pool, in the frame table. */
 struct frame {
 	void *kva;
 	struct page *page;
+
+	/* Your implementation */
+	uint64_t *pml4;        /* Page table that maps PAGE. */
+	bool pinned;           /* Being loaded or evicted, so no victim. */
+	bool writing;          /* PAGE being written out, unlocked? */
+	struct condition written; /* Signaled when WRITING turns false. */
+	bool hot;              /* On 2Q's hot queue? */
+	struct list_elem elem; /* In a replacement policy's queue. */
+};
+
+/* Frame table statistics. */
+struct frame_stats {
+	const char *policy;             /* Replacement policy's name. */
+	size_t frame_cnt;               /* Frames in the user pool. */
+	size_t used_cnt;                /* Frames holding a page. */
+	uint64_t page_ins;              /* Pages brought into frames. */
+	uint64_t evictions;             /* Pages evicted. */
+	uint64_t scans;                 /* Frames passed by the clock hand. */
+	uint64_t writebacks;            /* Evicted pages that were written. */
 };
 
 /* The function table for page operations.
@@ -82,9 +106,25 @@ struct page_operations {
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
 /* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+ *
+ * A radix tree keyed on the user page number, SPT_BITS bits per
+ * level, much like the page table it shadows: a lookup takes
+ * SPT_LEVELS steps with no hashing, and unused stretches of the
+ * address space take no memory.  Nodes are small enough to come
+ * from a slab cache, so a sparse process pays little for them.
+ *
+ * The table holds only pages that have been touched.  The rest of
+ * the address space is described by VMAs (see vm/vma.h), from
+ * which pages are created on their first fault. */
+#define SPT_BITS 6                      /* Page number bits per level. */
+#define SPT_FANOUT (1 << SPT_BITS)      /* Slots per node. */
+#define SPT_LEVELS 5                    /* Covers 2**30 user pages. */
+
+struct spt_node;
 struct supplemental_page_table {
+	struct spt_node *root;          /* Top of the tree, or null if empty. */
+	size_t page_cnt;                /* Number of pages in the tree. */
+	struct rbtree vmas;             /* struct vma, by start address. */
 };
 
 #include "threads/thread.h"
@@ -96,8 +136,11 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+void spt_remove_range (struct supplemental_page_table *spt,
+		void *start, void *end);
 
 void vm_init (void);
+bool vm_set_evict_policy (const char *name);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -106,6 +149,10 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
+void vm_free_frame (struct page *page, bool write_back);
+struct frame *vm_get_free_frame (void);
+void vm_install_frame (struct page *page, struct frame *frame);
+void vm_get_frame_stats (struct frame_stats *);
 bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
 
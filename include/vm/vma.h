@@ -0,0 +1,50 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <rbtree.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/vm.h"
+
+struct file;
+struct page;
+struct supplemental_page_table;
+
+/* Marks the VMA of a process's stack, which may grow down. */
+#define VM_STACK VM_MARKER_0
+
+/* The most a stack VMA may grow to. */
+#define STACK_MAX (1 << 20)
+
+/* A virtual memory area: a page-aligned run of a process's
+ * address space with one backing and one set of permissions, such
+ * as an ELF segment, an mmap()ed file or the stack.  Faults in a
+ * VMA create its struct pages one at a time, on first touch, so
+ * setting up or tearing down a VMA costs the same whatever its
+ * length. */
+struct vma {
+	void *start;                    /* First page. */
+	void *end;                      /* Page after the last. */
+	enum vm_type type;              /* VM_ANON or VM_FILE, with markers. */
+	bool writable;                  /* May user code write to it? */
+	struct file *file;              /* Backing file, or null. */
+	off_t offset;                   /* Offset in FILE of START. */
+	size_t read_bytes;              /* Bytes from FILE; the rest are zero. */
+	struct rbtree_elem elem;        /* In the supplemental page table. */
+};
+
+void vma_init (void);
+void vma_tree_init (struct supplemental_page_table *);
+struct vma *vma_map (struct supplemental_page_table *, void *start,
+		size_t length, enum vm_type, bool writable,
+		struct file *, off_t offset, size_t read_bytes);
+void vma_unmap (struct supplemental_page_table *, struct vma *);
+struct vma *vma_find (struct supplemental_page_table *, const void *va);
+bool vma_grow_down (struct supplemental_page_table *, struct vma *,
+		void *start);
+struct page *vma_alloc_page (struct vma *, void *upage);
+bool vma_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src);
+void vma_tree_kill (struct supplemental_page_table *);
+
+#endif /* vm/vma.h */
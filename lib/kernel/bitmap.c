@@ -4,6 +4,8 @@
 #include <round.h>
 #include <stdio.h>
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 #ifdef FILESYS
 #include "filesys/file.h"
 #endif
@@ -68,13 +70,17 @@ last_mask (const struct bitmap *b) {
 /* Initializes B to be a bitmap of BIT_CNT bits
    and sets all of its bits to false.
    Returns true if success, false if memory allocation
-   failed. */
+   failed.
+   Bits that would take more than a page come from vmalloc(),
+   which need not find that many contiguous free pages. */
 struct bitmap *
 bitmap_create (size_t bit_cnt) {
 	struct bitmap *b = malloc (sizeof *b);
 	if (b != NULL) {
+		size_t size = byte_cnt (bit_cnt);
+
 		b->bit_cnt = bit_cnt;
-		b->bits = malloc (byte_cnt (bit_cnt));
+		b->bits = size > PGSIZE ? vmalloc (size) : malloc (size);
 		if (b->bits != NULL || bit_cnt == 0) {
 			bitmap_set_all (b, false);
 			return b;
@@ -112,7 +118,10 @@ bitmap_buf_size (size_t bit_cnt) {
 void
 bitmap_destroy (struct bitmap *b) {
 	if (b != NULL) {
-		free (b->bits);
+		if (is_vmalloc_vaddr (b->bits))
+			vfree (b->bits);
+		else
+			free (b->bits);
 		free (b);
 	}
 }
@@ -0,0 +1,191 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a heap-ordered multiway tree.  Each node
+   keeps a pointer to its leftmost child and the children of a
+   node form a doubly linked sibling list; the `prev' link of a
+   leftmost child points back to the parent instead.  The root
+   has null `prev' and `next' links.
+
+   Insertion melds a one-node tree with the root.  Removing the
+   minimum melds the root's children together in two passes: left
+   to right in pairs, then the resulting trees right to left.
+   This "two-pass" combining is what gives the O(log n) amortized
+   bound.
+
+   An element that is not in any heap has a null `prev' link and
+   is not a root, which is how heap_contains() tells them apart.
+   Elements should therefore be zero-initialized (or removed with
+   heap_remove()/heap_pop_min()) before heap_contains() is used on
+   them. */
+
+static struct heap_elem *meld (struct heap *,
+		struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+static void reset (struct heap_elem *);
+
+/* Initializes H as an empty heap ordered by LESS given auxiliary
+   data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux) {
+	ASSERT (h != NULL);
+	ASSERT (less != NULL);
+
+	h->root = NULL;
+	h->elem_cnt = 0;
+	h->less = less;
+	h->aux = aux;
+}
+
+/* Inserts E into H. */
+void
+heap_insert (struct heap *h, struct heap_elem *e) {
+	ASSERT (h != NULL);
+	ASSERT (e != NULL);
+
+	reset (e);
+	h->root = meld (h, h->root, e);
+	h->elem_cnt++;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e) {
+	struct heap_elem *sub;
+
+	ASSERT (heap_contains (h, e));
+
+	if (e == h->root) {
+		heap_pop_min (h);
+		return;
+	}
+
+	/* Unlink E (and its subtree) from its parent or sibling. */
+	if (e->prev->child == e)
+		e->prev->child = e->next;
+	else
+		e->prev->next = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+
+	/* Put E's children back into the heap. */
+	sub = merge_pairs (h, e->child);
+	reset (e);
+	h->root = meld (h, h->root, sub);
+	h->elem_cnt--;
+}
+
+/* Returns the minimum element in H, or a null pointer if H is
+   empty. */
+struct heap_elem *
+heap_min (const struct heap *h) {
+	ASSERT (h != NULL);
+	return h->root;
+}
+
+/* Removes and returns the minimum element in H, or returns a
+   null pointer if H is empty. */
+struct heap_elem *
+heap_pop_min (struct heap *h) {
+	struct heap_elem *min;
+
+	ASSERT (h != NULL);
+
+	min = h->root;
+	if (min == NULL)
+		return NULL;
+
+	h->root = merge_pairs (h, min->child);
+	reset (min);
+	h->elem_cnt--;
+	return min;
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (const struct heap *h) {
+	return h->elem_cnt;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+heap_empty (const struct heap *h) {
+	return h->root == NULL;
+}
+
+/* Returns true if E is currently in H.  E must be in H or in no
+   heap at all; see the comment at the top of this file. */
+bool
+heap_contains (const struct heap *h, const struct heap_elem *e) {
+	return e == h->root || e->prev != NULL;
+}
+
+/* Melds the trees rooted at A and B, either of which may be
+   null, and returns the new root. */
+static struct heap_elem *
+meld (struct heap *h, struct heap_elem *a, struct heap_elem *b) {
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+
+	if (h->less (b, a, h->aux)) {
+		struct heap_elem *tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	/* Make B the leftmost child of A. */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Combines the sibling list starting at FIRST into a single tree
+   using two-pass pairing and returns its root. */
+static struct heap_elem *
+merge_pairs (struct heap *h, struct heap_elem *first) {
+	struct heap_elem *pairs = NULL;
+	struct heap_elem *root = NULL;
+
+	/* First pass: meld siblings left to right in pairs, stacking
+	   the results on PAIRS (linked through `next'). */
+	while (first != NULL) {
+		struct heap_elem *a = first;
+		struct heap_elem *b = a->next;
+		struct heap_elem *m;
+
+		if (b == NULL) {
+			first = NULL;
+			a->prev = NULL;
+			m = a;
+		} else {
+			first = b->next;
+			a->prev = a->next = NULL;
+			b->prev = b->next = NULL;
+			m = meld (h, a, b);
+		}
+		m->next = pairs;
+		pairs = m;
+	}
+
+	/* Second pass: meld the pairs right to left. */
+	while (pairs != NULL) {
+		struct heap_elem *next = pairs->next;
+		pairs->next = NULL;
+		root = meld (h, root, pairs);
+		pairs = next;
+	}
+	if (root != NULL)
+		root->prev = root->next = NULL;
+	return root;
+}
+
+/* Clears E's links. */
+static void
+reset (struct heap_elem *e) {
+	e->child = e->next = e->prev = NULL;
+}
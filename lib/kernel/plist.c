@@ -0,0 +1,167 @@
+#include "plist.h"
+#include "../debug.h"
+
+/* The elements of a plist are on `nodes' in order of decreasing
+   priority, and in order of insertion within a priority.  The
+   first element of each run of equal priority, its bucket's head,
+   is also on `heads', so `heads' has one element per distinct
+   priority, in the same order.  An element that is not a bucket
+   head has null `head' links.
+
+   Appending to a bucket means inserting just before the head of
+   the next lower bucket on `nodes' (or at its end), which is found
+   on `heads' without looking at the rest of the bucket.
+
+   An element that is not in any plist has null `node' links,
+   which is how plist_queued() recognizes it.  Elements should
+   therefore be zero-initialized before plist_queued() is used on
+   them. */
+
+static struct plist_elem *head_entry (struct list_elem *);
+static struct list_elem *bucket_end (struct plist *, struct list_elem *);
+static bool is_head (const struct plist_elem *);
+
+/* Initializes PL as an empty plist. */
+void
+plist_init (struct plist *pl) {
+	ASSERT (pl != NULL);
+
+	list_init (&pl->nodes);
+	list_init (&pl->heads);
+}
+
+/* Inserts E into PL with the given PRIORITY, behind any elements
+   of the same priority already there. */
+void
+plist_insert (struct plist *pl, struct plist_elem *e, int priority) {
+	struct list_elem *h;
+
+	ASSERT (pl != NULL);
+	ASSERT (e != NULL);
+
+	e->priority = priority;
+	for (h = list_begin (&pl->heads); h != list_end (&pl->heads);
+			h = list_next (h))
+		if (head_entry (h)->priority <= priority)
+			break;
+
+	if (h != list_end (&pl->heads) && head_entry (h)->priority == priority) {
+		/* Join the tail of an existing bucket. */
+		list_insert (bucket_end (pl, list_next (h)), &e->node);
+		e->head.prev = e->head.next = NULL;
+	} else {
+		/* Start a new bucket just before H's. */
+		list_insert (bucket_end (pl, h), &e->node);
+		list_insert (h, &e->head);
+	}
+}
+
+/* Removes E, which must be in PL, from PL. */
+void
+plist_remove (struct plist *pl, struct plist_elem *e) {
+	ASSERT (pl != NULL);
+	ASSERT (e != NULL);
+
+	if (is_head (e)) {
+		/* Hand the bucket over to the next element, if any. */
+		struct list_elem *n = list_next (&e->node);
+
+		if (n != list_end (&pl->nodes)) {
+			struct plist_elem *next = list_entry (n, struct plist_elem, node);
+			if (next->priority == e->priority)
+				list_insert (&e->head, &next->head);
+		}
+		list_remove (&e->head);
+		e->head.prev = e->head.next = NULL;
+	}
+	list_remove (&e->node);
+	e->node.prev = e->node.next = NULL;
+}
+
+/* Moves E, which must be in PL, to the tail of the bucket for
+   PRIORITY.  Does nothing if E is already filed under PRIORITY. */
+void
+plist_requeue (struct plist *pl, struct plist_elem *e, int priority) {
+	if (e->priority == priority)
+		return;
+	plist_remove (pl, e);
+	plist_insert (pl, e, priority);
+}
+
+/* Returns the element of highest priority in PL, the earliest
+   inserted among equals, or a null pointer if PL is empty. */
+struct plist_elem *
+plist_front (struct plist *pl) {
+	ASSERT (pl != NULL);
+
+	if (list_empty (&pl->nodes))
+		return NULL;
+	return list_entry (list_front (&pl->nodes), struct plist_elem, node);
+}
+
+/* Removes and returns the element plist_front() would return, or
+   returns a null pointer if PL is empty. */
+struct plist_elem *
+plist_pop_front (struct plist *pl) {
+	struct plist_elem *e = plist_front (pl);
+
+	if (e != NULL)
+		plist_remove (pl, e);
+	return e;
+}
+
+/* Returns the first element of PL in priority order, or a null
+   pointer if PL is empty.  Together with plist_next() this
+   iterates over PL; elements must not be inserted or requeued
+   while doing so, but the current one may be removed after its
+   successor has been obtained. */
+struct plist_elem *
+plist_begin (struct plist *pl) {
+	return plist_front (pl);
+}
+
+/* Returns the element after E in PL, or a null pointer if E is
+   the last one. */
+struct plist_elem *
+plist_next (struct plist *pl, struct plist_elem *e) {
+	struct list_elem *n = list_next (&e->node);
+
+	if (n == list_end (&pl->nodes))
+		return NULL;
+	return list_entry (n, struct plist_elem, node);
+}
+
+/* Returns true if E is in some plist, false otherwise.  See the
+   comment at the top of this file. */
+bool
+plist_queued (const struct plist_elem *e) {
+	return e->node.next != NULL;
+}
+
+/* Returns true if PL is empty, false otherwise. */
+bool
+plist_empty (struct plist *pl) {
+	return list_empty (&pl->nodes);
+}
+
+/* Returns the plist element whose `head' member is H. */
+static struct plist_elem *
+head_entry (struct list_elem *h) {
+	return list_entry (h, struct plist_elem, head);
+}
+
+/* Returns the position on PL's `nodes' where the bucket ends whose
+   successor on `heads' is H: the node of H's element, or the end
+   of `nodes' if H is the end of `heads'. */
+static struct list_elem *
+bucket_end (struct plist *pl, struct list_elem *h) {
+	if (h == list_end (&pl->heads))
+		return list_end (&pl->nodes);
+	return &head_entry (h)->node;
+}
+
+/* Returns true if E heads its bucket. */
+static bool
+is_head (const struct plist_elem *e) {
+	return e->head.next != NULL;
+}
@@ -0,0 +1,335 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* A red-black tree is a binary search tree whose nodes are
+   colored so that no red node has a red child and every path from
+   the root down to a null link passes the same number of black
+   nodes.  Together these keep the longest path within twice the
+   shortest, so the tree's height is O(log n).
+
+   Insertion adds a red leaf and then repairs any red-red pair by
+   recoloring up the tree, with at most two rotations.  Removal
+   unlinks a node with at most one child, swapping in the
+   successor first if needed, and if that took a black node away
+   from a path, moves the deficit up the tree until a red node or
+   a rotation absorbs it.  The repair code follows "Introduction
+   to Algorithms", chapter 13, with null links standing in for the
+   sentinel. */
+
+static void rotate_left (struct rbtree *, struct rbtree_elem *);
+static void rotate_right (struct rbtree *, struct rbtree_elem *);
+static void replace_child (struct rbtree *, struct rbtree_elem *parent,
+		struct rbtree_elem *old, struct rbtree_elem *new);
+static void remove_fixup (struct rbtree *, struct rbtree_elem *,
+		struct rbtree_elem *parent);
+static struct rbtree_elem *subtree_min (struct rbtree_elem *);
+
+/* Returns true if E is a red element, false if it is black or a
+   null link. */
+static inline bool
+is_red (const struct rbtree_elem *e) {
+	return e != NULL && e->red;
+}
+
+/* Initializes T as an empty tree ordered by LESS given auxiliary
+   data AUX. */
+void
+rbtree_init (struct rbtree *t, rbtree_less_func *less, void *aux) {
+	ASSERT (t != NULL);
+	ASSERT (less != NULL);
+
+	t->root = NULL;
+	t->elem_cnt = 0;
+	t->less = less;
+	t->aux = aux;
+}
+
+/* Inserts E into T, unless an element equal to it is already in
+   T.  Returns the equal element if there is one, otherwise a null
+   pointer. */
+struct rbtree_elem *
+rbtree_insert (struct rbtree *t, struct rbtree_elem *e) {
+	struct rbtree_elem **link = &t->root;
+	struct rbtree_elem *parent = NULL;
+
+	ASSERT (t != NULL);
+	ASSERT (e != NULL);
+
+	while (*link != NULL) {
+		parent = *link;
+		if (t->less (e, parent, t->aux))
+			link = &parent->left;
+		else if (t->less (parent, e, t->aux))
+			link = &parent->right;
+		else
+			return parent;
+	}
+	e->parent = parent;
+	e->left = e->right = NULL;
+	e->red = true;
+	*link = e;
+	t->elem_cnt++;
+
+	/* Repair red-red pairs up the tree. */
+	while (is_red (parent = e->parent)) {
+		/* PARENT is red, so it is not the root and has a parent. */
+		struct rbtree_elem *grand = parent->parent;
+
+		if (parent == grand->left) {
+			struct rbtree_elem *uncle = grand->right;
+
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+				continue;
+			}
+			if (e == parent->right) {
+				rotate_left (t, parent);
+				parent = e;
+			}
+			parent->red = false;
+			grand->red = true;
+			rotate_right (t, grand);
+			break;
+		} else {
+			struct rbtree_elem *uncle = grand->left;
+
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+				continue;
+			}
+			if (e == parent->left) {
+				rotate_right (t, parent);
+				parent = e;
+			}
+			parent->red = false;
+			grand->red = true;
+			rotate_left (t, grand);
+			break;
+		}
+	}
+	t->root->red = false;
+	return NULL;
+}
+
+/* Removes E, which must be in T, from T. */
+void
+rbtree_remove (struct rbtree *t, struct rbtree_elem *e) {
+	struct rbtree_elem *child, *parent;
+	bool removed_red;
+
+	ASSERT (t != NULL);
+	ASSERT (e != NULL);
+	ASSERT (t->elem_cnt > 0);
+
+	if (e->left == NULL || e->right == NULL) {
+		/* Unlink E itself. */
+		child = e->left != NULL ? e->left : e->right;
+		parent = e->parent;
+		removed_red = e->red;
+		if (child != NULL)
+			child->parent = parent;
+		replace_child (t, parent, e, child);
+	} else {
+		/* Unlink E's successor, which has no left child, and put it
+		   in E's place. */
+		struct rbtree_elem *succ = subtree_min (e->right);
+
+		removed_red = succ->red;
+		child = succ->right;
+		if (succ->parent == e)
+			parent = succ;
+		else {
+			parent = succ->parent;
+			parent->left = child;
+			if (child != NULL)
+				child->parent = parent;
+			succ->right = e->right;
+			succ->right->parent = succ;
+		}
+		succ->left = e->left;
+		succ->left->parent = succ;
+		succ->parent = e->parent;
+		succ->red = e->red;
+		replace_child (t, e->parent, e, succ);
+	}
+	t->elem_cnt--;
+
+	if (!removed_red)
+		remove_fixup (t, child, parent);
+}
+
+/* Returns the element in T equal to KEY, or a null pointer if
+   there is none. */
+struct rbtree_elem *
+rbtree_find (const struct rbtree *t, const struct rbtree_elem *key) {
+	struct rbtree_elem *e = rbtree_floor (t, key);
+
+	return e != NULL && !t->less (e, key, t->aux) ? e : NULL;
+}
+
+/* Returns the greatest element in T that is less than or equal to
+   KEY, or a null pointer if all of them are greater. */
+struct rbtree_elem *
+rbtree_floor (const struct rbtree *t, const struct rbtree_elem *key) {
+	struct rbtree_elem *e = t->root;
+	struct rbtree_elem *floor = NULL;
+
+	while (e != NULL) {
+		if (t->less (key, e, t->aux))
+			e = e->left;
+		else {
+			floor = e;
+			e = e->right;
+		}
+	}
+	return floor;
+}
+
+/* Returns the least element in T, or a null pointer if T is
+   empty. */
+struct rbtree_elem *
+rbtree_min (const struct rbtree *t) {
+	return t->root != NULL ? subtree_min (t->root) : NULL;
+}
+
+/* Returns the element after E in its tree, or a null pointer if E
+   is the greatest. */
+struct rbtree_elem *
+rbtree_next (const struct rbtree_elem *e) {
+	if (e->right != NULL)
+		return subtree_min (e->right);
+	while (e->parent != NULL && e == e->parent->right)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the number of elements in T. */
+size_t
+rbtree_size (const struct rbtree *t) {
+	return t->elem_cnt;
+}
+
+/* Returns true if T contains no elements, false otherwise. */
+bool
+rbtree_empty (const struct rbtree *t) {
+	return t->root == NULL;
+}
+
+/* Moves E's right child into E's place and makes E its left
+   child. */
+static void
+rotate_left (struct rbtree *t, struct rbtree_elem *e) {
+	struct rbtree_elem *r = e->right;
+
+	e->right = r->left;
+	if (r->left != NULL)
+		r->left->parent = e;
+	r->parent = e->parent;
+	replace_child (t, e->parent, e, r);
+	r->left = e;
+	e->parent = r;
+}
+
+/* Moves E's left child into E's place and makes E its right
+   child. */
+static void
+rotate_right (struct rbtree *t, struct rbtree_elem *e) {
+	struct rbtree_elem *l = e->left;
+
+	e->left = l->right;
+	if (l->right != NULL)
+		l->right->parent = e;
+	l->parent = e->parent;
+	replace_child (t, e->parent, e, l);
+	l->right = e;
+	e->parent = l;
+}
+
+/* Makes NEW the child of PARENT, or T's root if PARENT is null,
+   that OLD was. */
+static void
+replace_child (struct rbtree *t, struct rbtree_elem *parent,
+		struct rbtree_elem *old, struct rbtree_elem *new) {
+	if (parent == NULL)
+		t->root = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+}
+
+/* Restores the balance of T after a black element was unlinked
+   from above E, a child of PARENT, leaving every path through E
+   one black element short.  E may be a null link. */
+static void
+remove_fixup (struct rbtree *t, struct rbtree_elem *e,
+		struct rbtree_elem *parent) {
+	while (e != t->root && !is_red (e)) {
+		if (e == parent->left) {
+			struct rbtree_elem *sib = parent->right;
+
+			if (sib->red) {
+				sib->red = false;
+				parent->red = true;
+				rotate_left (t, parent);
+				sib = parent->right;
+			}
+			if (!is_red (sib->left) && !is_red (sib->right)) {
+				sib->red = true;
+				e = parent;
+				parent = e->parent;
+				continue;
+			}
+			if (!is_red (sib->right)) {
+				sib->left->red = false;
+				sib->red = true;
+				rotate_right (t, sib);
+				sib = parent->right;
+			}
+			sib->red = parent->red;
+			parent->red = false;
+			sib->right->red = false;
+			rotate_left (t, parent);
+		} else {
+			struct rbtree_elem *sib = parent->left;
+
+			if (sib->red) {
+				sib->red = false;
+				parent->red = true;
+				rotate_right (t, parent);
+				sib = parent->left;
+			}
+			if (!is_red (sib->left) && !is_red (sib->right)) {
+				sib->red = true;
+				e = parent;
+				parent = e->parent;
+				continue;
+			}
+			if (!is_red (sib->left)) {
+				sib->right->red = false;
+				sib->red = true;
+				rotate_left (t, sib);
+				sib = parent->left;
+			}
+			sib->red = parent->red;
+			parent->red = false;
+			sib->left->red = false;
+			rotate_right (t, parent);
+		}
+		e = t->root;
+	}
+	if (e != NULL)
+		e->red = false;
+}
+
+/* Returns the least element of the subtree rooted at E. */
+static struct rbtree_elem *
+subtree_min (struct rbtree_elem *e) {
+	while (e->left != NULL)
+		e = e->left;
+	return e;
+}
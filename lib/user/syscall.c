@@ -194,3 +194,23 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+int
+sched_setaffinity (pid_t pid, unsigned mask) {
+	return syscall2 (SYS_SCHED_SETAFFINITY, pid, mask);
+}
+
+int
+futex_wait (unsigned *addr, unsigned expected, long long timeout_ms) {
+	return syscall3 (SYS_FUTEX_WAIT, addr, expected, timeout_ms);
+}
+
+int
+futex_wake (unsigned *addr, int n) {
+	return syscall2 (SYS_FUTEX_WAKE, addr, n);
+}
+
+int
+lockstat (bool reset) {
+	return syscall1 (SYS_LOCKSTAT, reset);
+}
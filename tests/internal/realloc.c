@@ -0,0 +1,100 @@
+/* Microbenchmark for realloc() in threads/malloc.c.
+
+   Grows buffers the way the kernel does, a few bytes at a time
+   (argument vectors, directory entry buffers) and a page at a
+   time (file descriptor tables), and reports how long each
+   realloc() takes on average.  Also checks that the contents
+   survive every resize.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/test.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* Number of times to repeat each pattern. */
+#define ROUNDS 64
+
+static void bench (const char *name, size_t start, size_t step, size_t end);
+static void fill (uint8_t *, size_t from, size_t to);
+static void verify (const uint8_t *, size_t size);
+
+/* Runs the realloc() patterns. */
+void
+test (void)
+{
+  bench ("small steps within size classes", 8, 8, 1024);
+  bench ("small steps across a big block", 1024, 64, 4 * PGSIZE);
+  bench ("page steps", PGSIZE, PGSIZE, 64 * PGSIZE);
+  bench ("shrinking big block", 64 * PGSIZE, -(size_t) PGSIZE, PGSIZE);
+  printf ("realloc: done\n");
+}
+
+/* Resizes a buffer from START bytes to END bytes, STEP bytes at
+   a time, ROUNDS times over, and prints the average time per
+   realloc() under NAME. */
+static void
+bench (const char *name, size_t start, size_t step, size_t end)
+{
+  int64_t elapsed = 0;
+  uint64_t calls = 0;
+  int round;
+
+  for (round = 0; round < ROUNDS; round++)
+    {
+      uint8_t *p = malloc (start);
+      size_t size = start;
+      int64_t begin;
+
+      ASSERT (p != NULL);
+      fill (p, 0, size);
+
+      begin = timer_ns ();
+      while (size != end)
+        {
+          size_t new_size = size + step;
+
+          p = realloc (p, new_size);
+          ASSERT (p != NULL);
+          calls++;
+          if (new_size > size)
+            fill (p, size, new_size);
+          size = new_size;
+        }
+      elapsed += timer_ns () - begin;
+
+      verify (p, size);
+      free (p);
+    }
+
+  printf ("realloc: %s: %"PRIu64" calls, %"PRId64" ns per call "
+          "(including fill)\n", name, calls, elapsed / (int64_t) calls);
+}
+
+/* Sets bytes FROM...TO of P to a pattern that verify() knows. */
+static void
+fill (uint8_t *p, size_t from, size_t to)
+{
+  size_t i;
+
+  for (i = from; i < to; i++)
+    p[i] = i * 7 + 3;
+}
+
+/* Checks that the first SIZE bytes of P hold fill()'s pattern. */
+static void
+verify (const uint8_t *p, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    ASSERT (p[i] == (uint8_t) (i * 7 + 3));
+}
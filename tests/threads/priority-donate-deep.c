@@ -0,0 +1,82 @@
+/* Like priority-donate-chain, but with a chain of locks far
+   deeper than any fixed limit on the nesting of donations.
+
+   The main thread sets its priority to PRI_MIN and acquires lock
+   0.  It then creates CHAIN_DEPTH threads with priorities
+   PRI_MIN + 1, PRI_MIN + 2, ...  Thread i acquires lock i and then
+   blocks on lock i - 1, so that every new thread's priority has
+   to travel all the way down the chain to the main thread, which
+   checks that it arrived.
+
+   When the main thread releases lock 0, each thread in turn gets
+   its lock at the priority of the last thread and hands it on;
+   then the threads finish in order of decreasing priority, each
+   back at its own. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define CHAIN_DEPTH 40
+
+struct lock_pair
+  {
+    struct lock *first;         /* Lock to hold. */
+    struct lock *second;        /* Lock to wait for. */
+  };
+
+static thread_func chain_thread_func;
+
+void
+test_priority_donate_deep (void)
+{
+  static struct lock locks[CHAIN_DEPTH + 1];
+  static struct lock_pair lock_pairs[CHAIN_DEPTH + 1];
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_MIN);
+
+  for (i = 0; i <= CHAIN_DEPTH; i++)
+    lock_init (&locks[i]);
+
+  lock_acquire (&locks[0]);
+  msg ("%s got lock.", thread_name ());
+
+  for (i = 1; i <= CHAIN_DEPTH; i++)
+    {
+      char name[16];
+      int thread_priority = PRI_MIN + i;
+
+      snprintf (name, sizeof name, "thread %d", i);
+      lock_pairs[i].first = &locks[i];
+      lock_pairs[i].second = &locks[i - 1];
+      thread_create (name, thread_priority, chain_thread_func, &lock_pairs[i]);
+      msg ("%s should have priority %d.  Actual priority: %d.",
+           thread_name (), thread_priority, thread_get_priority ());
+    }
+
+  lock_release (&locks[0]);
+  msg ("%s finishing with priority %d.", thread_name (),
+       thread_get_priority ());
+}
+
+static void
+chain_thread_func (void *locks_)
+{
+  struct lock_pair *locks = locks_;
+
+  lock_acquire (locks->first);
+  lock_acquire (locks->second);
+  msg ("%s got lock with priority %d.", thread_name (),
+       thread_get_priority ());
+
+  lock_release (locks->second);
+  lock_release (locks->first);
+  msg ("%s finishing with priority %d.", thread_name (),
+       thread_get_priority ());
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+my ($depth) = 40;
+my (@expected) = ("(priority-donate-deep) begin",
+		  "(priority-donate-deep) main got lock.");
+push (@expected, "(priority-donate-deep) main should have priority $_.  "
+      . "Actual priority: $_.") foreach 1...$depth;
+push (@expected, "(priority-donate-deep) thread $_ got lock with priority "
+      . "$depth.") foreach 1...$depth;
+push (@expected, "(priority-donate-deep) thread $_ finishing with priority "
+      . "$_.") foreach reverse 1...$depth;
+push (@expected, "(priority-donate-deep) main finishing with priority 0.",
+      "(priority-donate-deep) end");
+
+check_expected ([join ('', map ("$_\n", @expected))]);
+pass;
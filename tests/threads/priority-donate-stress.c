@@ -0,0 +1,130 @@
+/* Stresses priority donation through nested locks on several
+   CPUs.
+
+   THREAD_CNT threads of assorted priorities each take a random
+   run of the LOCK_CNT locks, always in increasing order so that
+   they cannot deadlock, and then give them up again in reverse
+   order.  Donation chains of changing shape keep forming and
+   dissolving while they do.
+
+   Every lock guards a counter that its holder increments with a
+   yield in between reading and writing it, so that a lock that
+   ever failed to exclude would lose updates.  After giving up all
+   of its locks, every thread must be back at its own priority.
+   The test fails on a lost update or a leftover donation; a
+   corrupted wait queue is likely to crash or hang it. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 16           /* Number of threads. */
+#define LOCK_CNT 8              /* Number of locks. */
+#define ITER_CNT 200            /* Lock runs taken by each thread. */
+
+struct stress_info
+  {
+    int id;                     /* Thread number. */
+    int priority;               /* Thread's own priority. */
+    unsigned seed;              /* Random number state. */
+    int acquired;               /* Number of locks acquired. */
+    struct semaphore *done;     /* Upped on exit. */
+  };
+
+static struct lock locks[LOCK_CNT];
+static int counters[LOCK_CNT];
+
+static thread_func stress_thread;
+static unsigned next_random (unsigned *);
+
+void
+test_priority_donate_stress (void)
+{
+  static struct stress_info info[THREAD_CNT];
+  struct semaphore done;
+  int total = 0, acquired = 0;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  for (i = 0; i < LOCK_CNT; i++)
+    lock_init (&locks[i]);
+  sema_init (&done, 0);
+
+  msg ("Starting %d threads on %d locks.", THREAD_CNT, LOCK_CNT);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      info[i] = (struct stress_info) {
+        .id = i,
+        .priority = PRI_DEFAULT - THREAD_CNT / 2 + i,
+        .seed = 12345 + i * 7919,
+        .done = &done,
+      };
+      snprintf (name, sizeof name, "stress %d", i);
+      thread_create (name, info[i].priority, stress_thread, &info[i]);
+    }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < LOCK_CNT; i++)
+    total += counters[i];
+  for (i = 0; i < THREAD_CNT; i++)
+    acquired += info[i].acquired;
+  if (total != acquired)
+    fail ("locks acquired %d times but counters add up to %d",
+          acquired, total);
+  msg ("All threads finished.");
+  pass ();
+}
+
+/* Takes ITER_CNT random runs of locks. */
+static void
+stress_thread (void *info_)
+{
+  struct stress_info *info = info_;
+  int iter;
+
+  for (iter = 0; iter < ITER_CNT; iter++)
+    {
+      int first = next_random (&info->seed) % LOCK_CNT;
+      int last = first + next_random (&info->seed) % (LOCK_CNT - first);
+      int i;
+
+      for (i = first; i <= last; i++)
+        {
+          int value;
+
+          lock_acquire (&locks[i]);
+          if (thread_get_priority () < info->priority)
+            fail ("%s below its own priority", thread_name ());
+          value = counters[i];
+          thread_yield ();
+          counters[i] = value + 1;
+          info->acquired++;
+        }
+      for (i = last; i >= first; i--)
+        lock_release (&locks[i]);
+
+      if (thread_get_priority () != info->priority)
+        fail ("%s holds no locks but has priority %d instead of %d",
+              thread_name (), thread_get_priority (), info->priority);
+    }
+  sema_up (info->done);
+}
+
+/* Returns a pseudo-random number from the linear congruential
+   generator whose state is *SEED.  Each thread has its own, since
+   the kernel's random_ulong() is not safe to call from several
+   CPUs at once. */
+static unsigned
+next_random (unsigned *seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 16;
+}
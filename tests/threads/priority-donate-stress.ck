@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-stress) begin
+(priority-donate-stress) Starting 16 threads on 8 locks.
+(priority-donate-stress) All threads finished.
+(priority-donate-stress) PASS
+(priority-donate-stress) end
+EOF
+pass;
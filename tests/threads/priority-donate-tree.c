@@ -0,0 +1,103 @@
+/* Checks that priority donation falls back correctly when one of
+   several nested donations goes away.
+
+   The main thread sets its priority to PRI_MIN and acquires locks
+   A and B.  A chain of BRANCH_DEPTH threads forms behind B, as in
+   priority-donate-deep, raising the main thread to PRI_MIN +
+   BRANCH_DEPTH; then a chain of higher priority forms behind A,
+   raising it to PRI_MIN + 2 * BRANCH_DEPTH.
+
+   Releasing A lets A's chain run to completion.  Afterward the
+   main thread must be back at the priority that B's chain still
+   donates, not at its own.  Releasing B then lets B's chain run,
+   and the main thread finishes at PRI_MIN. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define BRANCH_DEPTH 12
+
+struct lock_pair
+  {
+    struct lock *first;         /* Lock to hold. */
+    struct lock *second;        /* Lock to wait for. */
+  };
+
+struct branch
+  {
+    struct lock locks[BRANCH_DEPTH + 1];
+    struct lock_pair lock_pairs[BRANCH_DEPTH + 1];
+  };
+
+static void make_branch (struct branch *, const char *name, int base_priority);
+static thread_func chain_thread_func;
+
+void
+test_priority_donate_tree (void)
+{
+  static struct branch a, b;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_MIN);
+
+  lock_init (&a.locks[0]);
+  lock_init (&b.locks[0]);
+  lock_acquire (&a.locks[0]);
+  lock_acquire (&b.locks[0]);
+  msg ("%s got locks a and b.", thread_name ());
+
+  make_branch (&b, "b", PRI_MIN);
+  make_branch (&a, "a", PRI_MIN + BRANCH_DEPTH);
+
+  lock_release (&a.locks[0]);
+  msg ("%s should have priority %d.  Actual priority: %d.",
+       thread_name (), PRI_MIN + BRANCH_DEPTH, thread_get_priority ());
+
+  lock_release (&b.locks[0]);
+  msg ("%s finishing with priority %d.", thread_name (),
+       thread_get_priority ());
+}
+
+/* Creates a chain of threads NAME 1...NAME BRANCH_DEPTH, with
+   priorities BASE_PRIORITY + 1 and up, waiting for BR's lock 0. */
+static void
+make_branch (struct branch *br, const char *name, int base_priority)
+{
+  int i;
+
+  for (i = 1; i <= BRANCH_DEPTH; i++)
+    {
+      char thread_name_[16];
+      int thread_priority = base_priority + i;
+
+      lock_init (&br->locks[i]);
+      br->lock_pairs[i].first = &br->locks[i];
+      br->lock_pairs[i].second = &br->locks[i - 1];
+      snprintf (thread_name_, sizeof thread_name_, "%s %d", name, i);
+      thread_create (thread_name_, thread_priority, chain_thread_func,
+                     &br->lock_pairs[i]);
+      msg ("%s should have priority %d.  Actual priority: %d.",
+           thread_name (), thread_priority, thread_get_priority ());
+    }
+}
+
+static void
+chain_thread_func (void *locks_)
+{
+  struct lock_pair *locks = locks_;
+
+  lock_acquire (locks->first);
+  lock_acquire (locks->second);
+  msg ("%s got lock with priority %d.", thread_name (),
+       thread_get_priority ());
+
+  lock_release (locks->second);
+  lock_release (locks->first);
+  msg ("%s finishing with priority %d.", thread_name (),
+       thread_get_priority ());
+}
@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+my ($depth) = 12;
+my (@expected) = ("(priority-donate-tree) begin",
+		  "(priority-donate-tree) main got locks a and b.");
+push (@expected, "(priority-donate-tree) main should have priority $_.  "
+      . "Actual priority: $_.") foreach 1...2 * $depth;
+
+# Releasing lock a runs branch a, then main is back at branch b's
+# priority.  Releasing lock b runs branch b.
+foreach my $branch (['a', $depth], ['b', 0]) {
+    my ($name, $base) = @$branch;
+    my ($top) = $base + $depth;
+    push (@expected, "(priority-donate-tree) $name $_ got lock with "
+	  . "priority $top.") foreach 1...$depth;
+    push (@expected, "(priority-donate-tree) $name $_ finishing with "
+	  . "priority " . ($base + $_) . ".") foreach reverse 1...$depth;
+    push (@expected, "(priority-donate-tree) main should have priority "
+	  . "$depth.  Actual priority: $depth.") if $name eq 'a';
+}
+push (@expected, "(priority-donate-tree) main finishing with priority 0.",
+      "(priority-donate-tree) end");
+
+check_expected ([join ('', map ("$_\n", @expected))]);
+pass;
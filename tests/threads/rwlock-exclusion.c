@@ -0,0 +1,115 @@
+/* Checks that a reader-writer lock lets readers in together but
+   keeps a writer alone.
+
+   First the main thread holds the lock for reading while a second
+   reader acquires it too; if readers excluded each other, this
+   would hang.  Then READER_CNT readers and WRITER_CNT writers
+   take the lock ITER_CNT times each, yielding while they hold it
+   so that others get a chance to barge in, and check each time
+   that no writer shares it with anyone. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define READER_CNT 6
+#define WRITER_CNT 3
+#define ITER_CNT 200
+
+static struct rwlock rw;
+static int readers_in, writers_in;      /* Holders now, updated atomically. */
+
+struct shared_reader
+  {
+    struct semaphore in;        /* Upped once it holds RW. */
+    struct semaphore out;       /* Downed before it releases RW. */
+  };
+
+static thread_func shared_reader, stress_reader, stress_writer;
+
+void
+test_rwlock_exclusion (void)
+{
+  struct shared_reader sr;
+  struct semaphore done;
+  int i;
+
+  rwlock_init (&rw);
+
+  /* Two readers at once. */
+  sema_init (&sr.in, 0);
+  sema_init (&sr.out, 0);
+  rwlock_acquire_read (&rw);
+  thread_create ("shared", PRI_DEFAULT, shared_reader, &sr);
+  sema_down (&sr.in);
+  msg ("Two readers hold the lock together.");
+  sema_up (&sr.out);
+  rwlock_release_read (&rw);
+
+  /* Readers and writers at random. */
+  msg ("Starting %d readers and %d writers.", READER_CNT, WRITER_CNT);
+  sema_init (&done, 0);
+  for (i = 0; i < READER_CNT + WRITER_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "%s %d",
+                i < READER_CNT ? "reader" : "writer", i);
+      thread_create (name, PRI_DEFAULT,
+                     i < READER_CNT ? stress_reader : stress_writer, &done);
+    }
+  for (i = 0; i < READER_CNT + WRITER_CNT; i++)
+    sema_down (&done);
+  msg ("All threads finished.");
+  pass ();
+}
+
+static void
+shared_reader (void *sr_)
+{
+  struct shared_reader *sr = sr_;
+
+  rwlock_acquire_read (&rw);
+  sema_up (&sr->in);
+  sema_down (&sr->out);
+  rwlock_release_read (&rw);
+}
+
+static void
+stress_reader (void *done)
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      rwlock_acquire_read (&rw);
+      __atomic_add_fetch (&readers_in, 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n (&writers_in, __ATOMIC_SEQ_CST) != 0)
+        fail ("reader got in with a writer");
+      thread_yield ();
+      __atomic_sub_fetch (&readers_in, 1, __ATOMIC_SEQ_CST);
+      rwlock_release_read (&rw);
+    }
+  sema_up (done);
+}
+
+static void
+stress_writer (void *done)
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      rwlock_acquire_write (&rw);
+      if (__atomic_add_fetch (&writers_in, 1, __ATOMIC_SEQ_CST) != 1)
+        fail ("two writers got in together");
+      if (__atomic_load_n (&readers_in, __ATOMIC_SEQ_CST) != 0)
+        fail ("writer got in with a reader");
+      thread_yield ();
+      __atomic_sub_fetch (&writers_in, 1, __ATOMIC_SEQ_CST);
+      rwlock_release_write (&rw);
+    }
+  sema_up (done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-exclusion) begin
+(rwlock-exclusion) Two readers hold the lock together.
+(rwlock-exclusion) Starting 6 readers and 3 writers.
+(rwlock-exclusion) All threads finished.
+(rwlock-exclusion) PASS
+(rwlock-exclusion) end
+EOF
+pass;
@@ -0,0 +1,112 @@
+/* Checks that a sequence lock makes readers retry reads that a
+   write overlapped, so that they never keep a torn copy.
+
+   First, in one thread: a read with no write during it must not
+   be retried, and one with a write during it must be.  Then a
+   writer updates a pair of counters, which must always be equal,
+   WRITE_CNT times, dawdling between the two stores, while
+   READER_CNT readers copy the pair out READ_CNT times each and
+   check that the copies they keep are equal.  Run with more than
+   one CPU for the writes to actually overlap the reads. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define READER_CNT 3
+#define READ_CNT 20000
+#define WRITE_CNT 20000
+
+static struct seqlock sl;
+static int pair[2];                     /* Always equal, under SL. */
+
+static thread_func reader, writer;
+static void write_pair (int);
+
+void
+test_seqlock_retry (void)
+{
+  struct semaphore done;
+  unsigned seq;
+  int i;
+
+  seqlock_init (&sl);
+
+  seq = seqlock_read_begin (&sl);
+  if (seqlock_read_retry (&sl, seq))
+    fail ("read retried with no write");
+  write_pair (1);
+  if (!seqlock_read_retry (&sl, seq))
+    fail ("read not retried after a write");
+  seq = seqlock_read_begin (&sl);
+  if (seqlock_read_retry (&sl, seq))
+    fail ("read after the write retried");
+  msg ("Overlapping reads are retried.");
+
+  msg ("Starting %d readers and 1 writer.", READER_CNT);
+  sema_init (&done, 0);
+  for (i = 0; i < READER_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT, reader, &done);
+    }
+  thread_create ("writer", PRI_DEFAULT, writer, &done);
+  for (i = 0; i < READER_CNT + 1; i++)
+    sema_down (&done);
+  msg ("No torn reads.");
+  pass ();
+}
+
+/* Sets both counters to VALUE, slowly. */
+static void
+write_pair (int value)
+{
+  enum intr_level old_level = intr_disable ();
+  int i;
+
+  seqlock_write_begin (&sl);
+  pair[0] = value;
+  for (i = 0; i < 100; i++)
+    barrier ();
+  pair[1] = value;
+  seqlock_write_end (&sl);
+  intr_set_level (old_level);
+}
+
+static void
+writer (void *done)
+{
+  int i;
+
+  for (i = 0; i < WRITE_CNT; i++)
+    write_pair (i);
+  sema_up (done);
+}
+
+static void
+reader (void *done)
+{
+  int i;
+
+  for (i = 0; i < READ_CNT; i++)
+    {
+      int a, b;
+      unsigned seq;
+
+      do
+        {
+          seq = seqlock_read_begin (&sl);
+          a = pair[0];
+          b = pair[1];
+        }
+      while (seqlock_read_retry (&sl, seq));
+      if (a != b)
+        fail ("read a torn pair %d, %d", a, b);
+    }
+  sema_up (done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(seqlock-retry) begin
+(seqlock-retry) Overlapping reads are retried.
+(seqlock-retry) Starting 3 readers and 1 writer.
+(seqlock-retry) No torn reads.
+(seqlock-retry) PASS
+(seqlock-retry) end
+EOF
+pass;
@@ -0,0 +1,159 @@
+/* Stresses the SMP load balancer.
+
+   The main thread pins itself to CPU 0 and creates BUSY_CNT
+   CPU-bound threads, which therefore all start out on CPU 0.
+   Each of them then allows itself to run anywhere, so it is up to
+   the balancer to spread them out.  One more CPU-bound thread
+   pins itself to the last CPU and must be moved there.
+   Meanwhile SLEEP_CNT threads sleep and wake up at short
+   intervals.
+
+   Every busy thread counts the timer ticks it sees on each CPU.
+   The totals per CPU are reported.  The test fails if some CPU
+   got less than half of its fair share of them, or if the pinned
+   thread was seen running anywhere but on its CPU. */
+
+#include <stdio.h>
+#include <limits.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define BUSY_CNT 12             /* Number of unpinned busy threads. */
+#define SLEEP_CNT 8             /* Number of sleeping threads. */
+#define TEST_TICKS (5 * TIMER_FREQ) /* Length of the test. */
+
+struct balance_info
+  {
+    int64_t end;                /* Tick at which to stop. */
+    unsigned affinity;          /* Affinity mask to set at start. */
+    int ticks[CPU_MAX];         /* Ticks seen on each CPU. */
+    int migrations;             /* Number of times seen to change CPU. */
+    int wakeups;                /* Number of times woken up. */
+    struct semaphore *done;     /* Upped on exit. */
+  };
+
+static thread_func busy_thread, sleep_thread;
+static int running_cpu (void);
+
+void
+test_smp_balance (void)
+{
+  struct balance_info busy[BUSY_CNT + 1], sleepers[SLEEP_CNT];
+  struct balance_info *pinned = &busy[BUSY_CNT];
+  struct semaphore done;
+  int total = 0, migrations = 0, wakeups = 0;
+  int64_t end;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("%d CPUs online.", cpu_cnt);
+  msg ("Starting %d busy and %d sleeping threads on CPU 0.",
+       BUSY_CNT + 1, SLEEP_CNT);
+
+  sema_init (&done, 0);
+  end = timer_ticks () + TEST_TICKS;
+  if (!thread_set_affinity (1))
+    fail ("could not pin main thread to CPU 0");
+
+  for (i = 0; i < BUSY_CNT + 1 + SLEEP_CNT; i++)
+    {
+      bool is_busy = i <= BUSY_CNT;
+      struct balance_info *info = is_busy ? &busy[i] : &sleepers[i - BUSY_CNT - 1];
+      char name[16];
+
+      *info = (struct balance_info) {
+        .end = end,
+        .affinity = info == pinned ? 1u << (cpu_cnt - 1) : UINT_MAX,
+        .done = &done,
+      };
+      snprintf (name, sizeof name, "%s %d", is_busy ? "busy" : "sleep", i);
+      thread_create (name, PRI_DEFAULT, is_busy ? busy_thread : sleep_thread,
+                     info);
+    }
+  thread_set_affinity (UINT_MAX);
+
+  for (i = 0; i < BUSY_CNT + 1 + SLEEP_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i <= BUSY_CNT; i++)
+    {
+      for (int cpu = 0; cpu < cpu_cnt; cpu++)
+        total += busy[i].ticks[cpu];
+      migrations += busy[i].migrations;
+    }
+  for (i = 0; i < SLEEP_CNT; i++)
+    wakeups += sleepers[i].wakeups;
+
+  for (int cpu = 0; cpu < cpu_cnt; cpu++)
+    {
+      int ticks = 0;
+
+      for (i = 0; i <= BUSY_CNT; i++)
+        ticks += busy[i].ticks[cpu];
+      msg ("CPU %d: %d busy ticks.", cpu, ticks);
+      if (ticks < total / cpu_cnt / 2)
+        fail ("CPU %d got %d of %d busy ticks, less than half its share",
+              cpu, ticks, total);
+    }
+  msg ("%d migrations, %d wakeups.", migrations, wakeups);
+
+  for (int cpu = 0; cpu < cpu_cnt - 1; cpu++)
+    if (pinned->ticks[cpu] != 0)
+      fail ("pinned thread ran on CPU %d", cpu);
+
+  pass ();
+}
+
+/* Spins until the end of the test, counting timer ticks. */
+static void
+busy_thread (void *info_)
+{
+  struct balance_info *info = info_;
+  int64_t last = -1, now;
+  int prev_cpu = -1;
+
+  thread_set_affinity (info->affinity);
+  while ((now = timer_ticks ()) < info->end)
+    if (now != last)
+      {
+        int cpu = running_cpu ();
+
+        info->ticks[cpu]++;
+        if (prev_cpu != -1 && cpu != prev_cpu)
+          info->migrations++;
+        prev_cpu = cpu;
+        last = now;
+      }
+  sema_up (info->done);
+}
+
+/* Sleeps for 1 to 4 ticks at a time until the end of the test. */
+static void
+sleep_thread (void *info_)
+{
+  struct balance_info *info = info_;
+
+  while (timer_ticks () < info->end)
+    {
+      timer_sleep (1 + info->wakeups % 4);
+      info->wakeups++;
+    }
+  sema_up (info->done);
+}
+
+/* Returns the CPU the running thread is on. */
+static int
+running_cpu (void)
+{
+  enum intr_level old_level = intr_disable ();
+  int cpu = thread_current ()->cpu;
+  intr_set_level (old_level);
+  return cpu;
+}
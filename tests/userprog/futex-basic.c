@@ -0,0 +1,25 @@
+/* Checks the futex calls that need no second thread: waiting on a
+   word that does not hold the expected value, waiting until a
+   timeout, waking a word that no one sleeps on, and a misaligned
+   address.  The word is in a page the program never touched
+   before. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static unsigned word;
+
+void
+test_main (void)
+{
+  CHECK (futex_wait (&word, 1, -1) == FUTEX_MISMATCH,
+         "wait on a word that differs");
+  CHECK (futex_wait (&word, 0, 10) == FUTEX_TIMEDOUT,
+         "wait until timeout");
+  CHECK (futex_wait (&word, 0, 0) == FUTEX_TIMEDOUT,
+         "wait with zero timeout");
+  CHECK (futex_wake (&word, 1) == 0, "wake with no sleepers");
+  CHECK (futex_wait ((unsigned *) ((char *) &word + 1), 0, 10)
+         == FUTEX_MISMATCH, "wait on a misaligned word");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex-basic) begin
+(futex-basic) wait on a word that differs
+(futex-basic) wait until timeout
+(futex-basic) wait with zero timeout
+(futex-basic) wake with no sleepers
+(futex-basic) wait on a misaligned word
+(futex-basic) end
+futex-basic: exit(0)
+EOF
+pass;
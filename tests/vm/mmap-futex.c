@@ -0,0 +1,46 @@
+/* Maps a file and forks.  The child sleeps on the first word of
+   its copy of the mapping, which it has not touched yet, and the
+   parent wakes it through its own copy: futexes in a file mapping
+   are the file's, not a frame's. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* The parent gives up waking the child after this many tries, 10
+   ms apart: well before the child's own wait times out. */
+#define WAKE_TRIES 500
+
+void
+test_main (void)
+{
+  unsigned *actual = (unsigned *) 0x10000000;
+  unsigned expected;
+  int handle;
+  pid_t child;
+  unsigned nap = 0;
+  int woken, status, tries;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (actual, 4096, 0, handle, 0) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+  memcpy (&expected, sample, sizeof expected);
+
+  child = fork ("child");
+  if (child == 0)
+    exit (futex_wait (actual, expected, 10000));
+
+  /* Until the child is asleep, there is no one to wake.  Between
+     tries, nap on a word no one wakes. */
+  for (tries = 0; (woken = futex_wake (actual, 1)) == 0; tries++)
+    {
+      if (tries == WAKE_TRIES)
+        fail ("child never slept on the futex");
+      futex_wait (&nap, 0, 10);
+    }
+  status = wait (child);
+  CHECK (woken == 1, "wake child");
+  CHECK (status == 0, "child was woken");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mmap-futex) begin
+(mmap-futex) open "sample.txt"
+(mmap-futex) mmap "sample.txt"
+child: exit(0)
+(mmap-futex) wake child
+(mmap-futex) child was woken
+(mmap-futex) end
+mmap-futex: exit(0)
+EOF
+pass;
@@ -0,0 +1,73 @@
+/* Benchmark for page replacement.
+
+   Works over a hot set of HOT_PAGES pages, touching each of them
+   every round, while sweeping through a region of SCAN_PAGES
+   pages, much more than fits in memory, a few pages a round.
+   Each swept page is touched only once per pass, so a policy that
+   lets the sweep push the hot set out of memory pays a fault for
+   every hot page, every round.  The sweep first only reads, then
+   also writes, so that its pages are first clean, then dirty.
+
+   The kernel prints its fault counts at power-off.  Run this
+   under each replacement policy with the same amount of user
+   memory and compare the "Frames:" lines, e.g.:
+
+     pintos -- -q -ul=256 -evict=clock run page-hot-scan
+     pintos -- -q -ul=256 -evict=2q run page-hot-scan
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HOT_PAGES 160                   /* Should fit in memory. */
+#define SCAN_PAGES 1024                 /* Should not. */
+#define SCAN_STEP 64                    /* Pages swept per round. */
+#define ROUNDS 256
+
+static char hot[HOT_PAGES][PAGE_SIZE];
+static char scan[SCAN_PAGES][PAGE_SIZE];
+
+static void run (const char *name, bool write_scan);
+
+void
+test_main (void)
+{
+  run ("hot set, read-only sweep", false);
+  run ("hot set, read/write sweep", true);
+}
+
+/* Runs ROUNDS rounds of the workload, sweeping through scan[] and
+   writing to it if WRITE_SCAN, and checks that the hot set held
+   its contents throughout. */
+static void
+run (const char *name, bool write_scan)
+{
+  size_t next = 0;
+  unsigned sum = 0;
+  int round;
+  size_t i;
+
+  msg ("%s", name);
+  for (i = 0; i < HOT_PAGES; i++)
+    memset (hot[i], i, PAGE_SIZE);
+
+  for (round = 0; round < ROUNDS; round++)
+    {
+      for (i = 0; i < HOT_PAGES; i++)
+        if (hot[i][round % PAGE_SIZE] != (char) i)
+          fail ("hot page %zu corrupted in round %d", i, round);
+
+      for (i = 0; i < SCAN_STEP; i++)
+        {
+          sum += scan[next][0];
+          if (write_scan)
+            scan[next][0] = round;
+          next = (next + 1) % SCAN_PAGES;
+        }
+    }
+  msg ("%s: done (%u)", name, sum);
+}
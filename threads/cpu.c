@@ -0,0 +1,270 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/lapic.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#include "userprog/tss.h"
+#endif
+
+/* Symmetric multiprocessing.
+
+   The bootstrap processor (BSP) runs main() and starts the others
+   (application processors, APs) from smp_init() once the kernel
+   is up.  Each AP comes in through the trampoline in ap-start.S,
+   which takes it from real mode to long mode on the kernel page
+   tables and calls ap_main() on the stack of its idle thread.
+
+   Device interrupts are delivered to the BSP only.  With "-apic"
+   every CPU runs its own local APIC timer; otherwise the BSP
+   forwards each 8254 timer tick to the APs as an inter-processor
+   interrupt so that they time-slice too. */
+
+#define MSR_GS_BASE 0xc0000101        /* %gs base. */
+#define MSR_KERNEL_GS_BASE 0xc0000102 /* Swapped with %gs base by swapgs. */
+
+/* Inter-processor interrupt vectors. */
+#define IPI_TICK 0xf0                 /* Forwarded timer tick. */
+#define IPI_RESCHED 0xf1              /* Check the run queue. */
+#define IPI_TLB 0xf2                  /* Flush the TLB. */
+#define IPI_CALL 0xf3                 /* Run smp_call()'s function. */
+
+struct cpu cpus[CPU_MAX];
+
+/* Number of CPUs online. */
+int cpu_cnt = 1;
+
+/* Number of CPUs to start, from the "-smp" kernel option. */
+int smp_ncpu = 1;
+
+/* Top of the stack the next AP starts on, for ap-start.S. */
+uint64_t ap_boot_stack;
+
+/* CPU being started. */
+static struct cpu *ap_booting;
+
+/* Serializes smp_flush_tlb() and smp_call(), and counts the CPUs
+   they still wait for.  Both wait with interrupts off, so sharing
+   one lock keeps two CPUs from each waiting on the other. */
+static struct lock ipi_wait_lock;
+static int ipi_wait_pending;
+
+/* Function for IPI_CALL to run, and its argument. */
+static void (*call_func) (void *aux);
+static void *call_aux;
+
+static intr_handler_func ipi_tick, ipi_resched, ipi_flush_tlb, ipi_call;
+void ap_main (void) NO_RETURN;
+
+/* Points the running CPU's %gs base at C. */
+static void
+cpu_setup (struct cpu *c) {
+	c->self = c;
+	list_init (&c->destruction_req);
+	write_msr (MSR_GS_BASE, (uint64_t) c);
+	write_msr (MSR_KERNEL_GS_BASE, 0);
+}
+
+/* Sets up the bootstrap processor's struct cpu.  Must be called
+   before anything uses cpu_current(), including locks. */
+void
+cpu_init (void) {
+	cpus[0].id = 0;
+	cpus[0].started = true;
+	cpu_setup (&cpus[0]);
+}
+
+/* Entered from ap-start.S by each AP, with interrupts off, on the
+   stack of the idle thread that thread_prepare_ap() made for it.
+   Must not sleep: there is no thread to switch to yet. */
+void
+ap_main (void) {
+	struct cpu *c = ap_booting;
+
+	cpu_setup (c);
+#ifdef USERPROG
+	tss_init ();
+	gdt_init ();
+	syscall_init ();
+#endif
+	intr_init_ap ();
+	lapic_init_ap ();
+	timer_init_ap ();
+	c->apic_id = lapic_id ();
+	c->started = true;
+
+	thread_start_ap ();
+}
+
+/* Starts the APs, up to smp_ncpu CPUs in all.  The bootstrap
+   processor must already be fully initialized, with interrupts
+   on. */
+void
+smp_init (void) {
+	extern const char ap_trampoline[], ap_trampoline_end[];
+	uint8_t bsp_id;
+
+	ASSERT (intr_get_level () == INTR_ON);
+
+	if (smp_ncpu > CPU_MAX)
+		smp_ncpu = CPU_MAX;
+	if (smp_ncpu <= 1)
+		return;
+	if (thread_mlfqs || timer_nohz) {
+		printf ("smp: -mlfqs and -nohz need a single CPU, "
+				"not starting others.\n");
+		return;
+	}
+	if (!lapic_init ()) {
+		printf ("smp: no local APIC, not starting other CPUs.\n");
+		return;
+	}
+
+	intr_register_lapic (IPI_TICK, ipi_tick, "Tick IPI");
+	intr_register_lapic (IPI_RESCHED, ipi_resched, "Reschedule IPI");
+	intr_register_lapic (IPI_TLB, ipi_flush_tlb, "TLB shootdown IPI");
+	intr_register_lapic (IPI_CALL, ipi_call, "Function call IPI");
+	lock_init (&ipi_wait_lock);
+
+	bsp_id = cpus[0].apic_id = lapic_id ();
+	memcpy (ptov (AP_TRAMPOLINE), ap_trampoline,
+			ap_trampoline_end - ap_trampoline);
+
+	/* QEMU numbers the local APICs 0...N-1. */
+	for (int apic_id = 0; apic_id < smp_ncpu; apic_id++) {
+		struct cpu *c = &cpus[cpu_cnt];
+		struct thread *idle;
+
+		if (apic_id == bsp_id)
+			continue;
+		if (cpu_cnt == smp_ncpu)
+			break;
+
+		c->id = cpu_cnt;
+		idle = thread_prepare_ap (c);
+		if (idle == NULL)
+			break;
+		ap_boot_stack = (uint64_t) idle + PGSIZE;
+		ap_booting = c;
+		lapic_start_ap (apic_id, AP_TRAMPOLINE);
+
+		for (int i = 0; i < 100 && !c->started; i++)
+			timer_msleep (1);
+		if (!c->started) {
+			/* The CPU may still show up later and use its stack,
+			   so the idle thread's page is never freed. */
+			printf ("smp: CPU with APIC ID %d did not start.\n", apic_id);
+			break;
+		}
+		cpu_cnt++;
+	}
+
+	printf ("smp: %d CPUs online.\n", cpu_cnt);
+}
+
+/* Forwards a timer tick to the other CPUs.  Called by the BSP's
+   8254 timer interrupt handler. */
+void
+smp_send_tick (void) {
+	for (int i = 1; i < cpu_cnt; i++)
+		lapic_send_ipi (cpus[i].apic_id, IPI_TICK);
+}
+
+/* Interrupts C so that it looks at its run queue again. */
+void
+smp_send_resched (struct cpu *c) {
+	lapic_send_ipi (c->apic_id, IPI_RESCHED);
+}
+
+/* Flushes the TLB of every CPU but the running one, and waits
+   until they all have.  Call after removing kernel mappings that
+   other CPUs may have cached, before the addresses are reused.
+   Must not be called with interrupts off, which could deadlock
+   against another CPU doing the same. */
+void
+smp_flush_tlb (void) {
+	enum intr_level old_level;
+	struct cpu *self;
+
+	ASSERT (!intr_context ());
+
+	if (cpu_cnt == 1)
+		return;
+
+	lock_acquire (&ipi_wait_lock);
+	old_level = intr_disable ();
+	self = cpu_current ();
+	__atomic_store_n (&ipi_wait_pending, cpu_cnt - 1, __ATOMIC_RELEASE);
+	for (int i = 0; i < cpu_cnt; i++)
+		if (&cpus[i] != self)
+			lapic_send_ipi (cpus[i].apic_id, IPI_TLB);
+	while (__atomic_load_n (&ipi_wait_pending, __ATOMIC_ACQUIRE) > 0)
+		asm volatile ("pause");
+	intr_set_level (old_level);
+	lock_release (&ipi_wait_lock);
+}
+
+/* Runs FUNC (AUX) on every CPU but the running one, from an
+   interrupt handler, and waits until they all have.  FUNC runs
+   with interrupts off and must not sleep.  Like smp_flush_tlb(),
+   must not be called with interrupts off. */
+void
+smp_call (void (*func) (void *aux), void *aux) {
+	enum intr_level old_level;
+	struct cpu *self;
+
+	ASSERT (!intr_context ());
+
+	if (cpu_cnt == 1)
+		return;
+
+	lock_acquire (&ipi_wait_lock);
+	old_level = intr_disable ();
+	self = cpu_current ();
+	call_func = func;
+	call_aux = aux;
+	__atomic_store_n (&ipi_wait_pending, cpu_cnt - 1, __ATOMIC_RELEASE);
+	for (int i = 0; i < cpu_cnt; i++)
+		if (&cpus[i] != self)
+			lapic_send_ipi (cpus[i].apic_id, IPI_CALL);
+	while (__atomic_load_n (&ipi_wait_pending, __ATOMIC_ACQUIRE) > 0)
+		asm volatile ("pause");
+	intr_set_level (old_level);
+	lock_release (&ipi_wait_lock);
+}
+
+/* Forwarded timer tick. */
+static void
+ipi_tick (struct intr_frame *f UNUSED) {
+	thread_tick ();
+}
+
+/* A thread was made ready on this CPU's run queue that should
+   preempt what we are running. */
+static void
+ipi_resched (struct intr_frame *f UNUSED) {
+	intr_yield_on_return ();
+}
+
+/* Another CPU removed mappings we may have cached.  Kernel
+   mappings are not global, so reloading %cr3 drops them all. */
+static void
+ipi_flush_tlb (struct intr_frame *f UNUSED) {
+	lcr3 (rcr3 ());
+	__atomic_sub_fetch (&ipi_wait_pending, 1, __ATOMIC_RELEASE);
+}
+
+/* Another CPU asked us to run a function, in smp_call(). */
+static void
+ipi_call (struct intr_frame *f UNUSED) {
+	call_func (call_aux);
+	__atomic_sub_fetch (&ipi_wait_pending, 1, __ATOMIC_RELEASE);
+}
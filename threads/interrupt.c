@@ -6,6 +6,9 @@
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/cpu.h"
+#include "threads/ioapic.h"
+#include "threads/lapic.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
@@ -99,12 +102,22 @@ static const char *intr_names[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.
+
+   This state is per-CPU, in struct cpu: in_external_intr (are we
+   processing an external interrupt?) and yield_on_return (should
+   we yield on interrupt return?).  Interrupts raised by the local
+   APIC itself, inter-processor interrupts and its timer, use
+   vectors 0xf0...0xfe.  They are treated as external interrupts
+   that are acknowledged at the local APIC instead of the PIC. */
+
+/* True once device interrupts come through the I/O APIC instead
+   of the PICs.  See intr_use_apic(). */
+static bool apic_mode;
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
+static void route_irq (int irq);
 static void pic_end_of_interrupt (int irq);
 
 /* Interrupt handlers. */
@@ -159,6 +172,13 @@ intr_disable (void) {
 	return old_level;
 }
 
+/* Returns true if VEC_NO is an external interrupt. */
+static bool
+is_external (uint64_t vec_no) {
+	return (vec_no >= 0x20 && vec_no < 0x30)
+		|| (vec_no >= 0xf0 && vec_no < LAPIC_SPURIOUS_VEC);
+}
+
 /* Initializes the interrupt system. */
 void
 intr_init (void) {
@@ -203,6 +223,16 @@ intr_init (void) {
 	intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Loads the IDT, and the TSS if there is one, on a secondary
+   CPU.  The IDT itself is shared by all CPUs. */
+void
+intr_init_ap (void) {
+#ifdef USERPROG
+	ltr (SEL_TSS);
+#endif
+	lidt (&idt_desc);
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -227,8 +257,27 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
+	enum intr_level old_level;
+
 	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
+
+	old_level = intr_disable ();
+	if (apic_mode)
+		route_irq (vec_no - 0x20);
+	intr_set_level (old_level);
+}
+
+/* Registers local APIC interrupt VEC_NO, an inter-processor
+   interrupt or the local APIC timer, to invoke HANDLER, which is
+   named NAME for debugging purposes.  Like an external interrupt,
+   the handler executes with interrupts disabled and may call
+   intr_yield_on_return(). */
+void
+intr_register_lapic (uint8_t vec_no, intr_handler_func *handler,
+		const char *name) {
+	ASSERT (vec_no >= 0xf0 && vec_no < LAPIC_SPURIOUS_VEC);
+	register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
 /* Registers internal interrupt VEC_NO to invoke HANDLER, which
@@ -248,7 +297,7 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (!is_external (vec_no));
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -256,6 +305,11 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
    and false at all other times. */
 bool
 intr_context (void) {
+	/* Keep the thread from moving to another CPU between finding
+	   its struct cpu and reading the flag. */
+	enum intr_level old_level = intr_disable ();
+	bool in_external_intr = cpu_current ()->in_external_intr;
+	intr_set_level (old_level);
 	return in_external_intr;
 }
 
@@ -266,7 +320,7 @@ intr_context (void) {
 void
 intr_yield_on_return (void) {
 	ASSERT (intr_context ());
-	yield_on_return = true;
+	cpu_current ()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -308,6 +362,41 @@ pic_init (void) {
 	outb (0xa1, 0x00);
 }
 
+/* Switches device interrupts from the PICs to the I/O APIC, which
+   delivers them to this CPU, the bootstrap processor.  Returns
+   false, leaving the PICs in charge, if there is no local APIC
+   or no I/O APIC.  Interrupts must be off. */
+bool
+intr_use_apic (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (apic_mode)
+		return true;
+	if (!lapic_init () || !ioapic_init ())
+		return false;
+
+	/* Mask the PICs, then route every interrupt that has a
+	   handler through the I/O APIC instead. */
+	outb (0x21, 0xff);
+	outb (0xa1, 0xff);
+	apic_mode = true;
+	for (int irq = 0; irq < 16; irq++)
+		if (intr_handlers[0x20 + irq] != NULL)
+			route_irq (irq);
+	return true;
+}
+
+/* Delivers ISA interrupt IRQ to this CPU through the I/O APIC.
+   IRQ 0, the 8254 timer, is left masked: in APIC mode the local
+   APIC timer takes its place. */
+static void
+route_irq (int irq) {
+	ASSERT (apic_mode);
+
+	if (irq != 0)
+		ioapic_route (irq, 0x20 + irq, lapic_id ());
+}
+
 /* Sends an end-of-interrupt signal to the PIC for the given IRQ.
    If we don't acknowledge the IRQ, it will never be delivered to
    us again, so this is important.  */
@@ -332,18 +421,21 @@ void
 intr_handler (struct intr_frame *frame) {
 	bool external;
 	intr_handler_func *handler;
+	struct cpu *c = NULL;
 
 	/* External interrupts are special.
 	   We only handle one at a time (so interrupts must be off)
-	   and they need to be acknowledged on the PIC (see below).
-	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	   and they need to be acknowledged on the PIC or local APIC
+	   (see below).  An external interrupt handler cannot sleep,
+	   so it stays on this CPU throughout. */
+	external = is_external (frame->vec_no);
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (!intr_context ());
 
-		in_external_intr = true;
-		yield_on_return = false;
+		c = cpu_current ();
+		c->in_external_intr = true;
+		c->yield_on_return = false;
 	}
 
 	/* Invoke the interrupt's handler. */
@@ -366,10 +458,13 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (intr_context ());
 
-		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
+		c->in_external_intr = false;
+		if (frame->vec_no < 0x30 && !apic_mode)
+			pic_end_of_interrupt (frame->vec_no);
+		else
+			lapic_eoi ();
 
-		if (yield_on_return)
+		if (c->yield_on_return)
 			thread_yield ();
 	}
 }
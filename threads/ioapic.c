@@ -0,0 +1,98 @@
+#include "threads/ioapic.h"
+#include <debug.h>
+#include <stddef.h>
+#include "threads/mmu.h"
+
+/* I/O APIC.  See [82093AA].
+
+   The I/O APIC takes the place of the 8259A PICs: it turns device
+   interrupt lines into messages to the local APICs.  Each input
+   has a redirection table entry that names the vector to raise
+   and the CPU to raise it on.  End of interrupt is signalled at
+   the local APIC, with a memory write instead of port I/O.
+
+   We assume the one I/O APIC at its default address, with ISA
+   IRQ N wired to input N, which is how QEMU and most PCs are set
+   up.  The exception is the 8254 timer on IRQ 0, which is wired
+   to input 2; we never route it, since the local APIC timer
+   replaces it. */
+
+#define IOAPIC_BASE 0xfec00000      /* Default physical address. */
+
+/* Memory-mapped registers, in 32-bit words: an index register
+   selects the register that the data window reads and writes. */
+#define IOREGSEL      0x00          /* Register select. */
+#define IOWIN         0x04          /* Data window. */
+
+/* Indirect registers. */
+#define IOAPICVER     0x01          /* Version and number of inputs. */
+#define IOREDTBL(N)   (0x10 + 2 * (N)) /* Redirection entry N, low half. */
+
+/* Redirection entry bits.  The defaults (all zero) are fixed
+   delivery to a physical APIC ID, edge triggered, active high,
+   which is right for ISA interrupts. */
+#define RED_MASKED    0x10000       /* Input masked. */
+
+/* Registers, mapped uncached into the kernel address space. */
+static volatile uint32_t *ioapic;
+
+/* Highest input number. */
+static int max_irq;
+
+static uint32_t ioapic_read (int reg);
+static void ioapic_write (int reg, uint32_t value);
+
+/* Maps the I/O APIC and masks all of its inputs.  Returns false
+   if there is no I/O APIC. */
+bool
+ioapic_init (void) {
+	uint32_t ver;
+
+	ioapic = mmio_map (IOAPIC_BASE);
+	if (ioapic == NULL)
+		return false;
+
+	/* Reads from an address nothing answers to return all ones. */
+	ver = ioapic_read (IOAPICVER);
+	if (ver == 0xffffffff) {
+		ioapic = NULL;
+		return false;
+	}
+	max_irq = (ver >> 16) & 0xff;
+
+	for (int irq = 0; irq <= max_irq; irq++)
+		ioapic_mask (irq);
+	return true;
+}
+
+/* Delivers interrupt line IRQ as vector VEC to the CPU whose
+   local APIC ID is APIC_ID. */
+void
+ioapic_route (int irq, uint8_t vec, uint8_t apic_id) {
+	ASSERT (ioapic != NULL);
+	ASSERT (irq >= 0 && irq <= max_irq);
+
+	ioapic_write (IOREDTBL (irq) + 1, (uint32_t) apic_id << 24);
+	ioapic_write (IOREDTBL (irq), vec);
+}
+
+/* Stops delivering interrupt line IRQ. */
+void
+ioapic_mask (int irq) {
+	ASSERT (ioapic != NULL);
+	ASSERT (irq >= 0 && irq <= max_irq);
+
+	ioapic_write (IOREDTBL (irq), RED_MASKED);
+}
+
+static uint32_t
+ioapic_read (int reg) {
+	ioapic[IOREGSEL] = reg;
+	return ioapic[IOWIN];
+}
+
+static void
+ioapic_write (int reg, uint32_t value) {
+	ioapic[IOREGSEL] = reg;
+	ioapic[IOWIN] = value;
+}
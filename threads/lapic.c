@@ -0,0 +1,214 @@
+#include "threads/lapic.h"
+#include <debug.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+/* Local APIC.  See [IA32-v3a] chapter 10 "Advanced Programmable
+   Interrupt Controller (APIC)".
+
+   Every CPU has its own local APIC, mapped at the same physical
+   address on all of them; an access always reaches the APIC of
+   the CPU that makes it.  We use it to send and receive
+   inter-processor interrupts and, with "-apic", for its timer.
+   Device interrupts come either through the 8259A PICs, which
+   are wired to the bootstrap processor's LINT0 pin in "virtual
+   wire" mode, or through the I/O APIC (see ioapic.c). */
+
+#define MSR_APIC_BASE 0x1b          /* APIC base address MSR. */
+#define APIC_BASE_ENABLE (1 << 11)  /* Global enable bit in the MSR. */
+
+/* Register offsets, in bytes. */
+#define LAPIC_ID      0x020         /* Local APIC ID. */
+#define LAPIC_TPR     0x080         /* Task priority. */
+#define LAPIC_EOI     0x0b0         /* End of interrupt. */
+#define LAPIC_SVR     0x0f0         /* Spurious interrupt vector. */
+#define LAPIC_ESR     0x280         /* Error status. */
+#define LAPIC_ICRLO   0x300         /* Interrupt command, low half. */
+#define LAPIC_ICRHI   0x310         /* Interrupt command, high half. */
+#define LAPIC_TIMER   0x320         /* Timer local vector table entry. */
+#define LAPIC_LINT0   0x350         /* Local interrupt pin 0. */
+#define LAPIC_LINT1   0x360         /* Local interrupt pin 1. */
+#define LAPIC_TICR    0x380         /* Timer initial count. */
+#define LAPIC_TCCR    0x390         /* Timer current count. */
+#define LAPIC_TDCR    0x3e0         /* Timer divide configuration. */
+
+#define SVR_ENABLE    0x100         /* Software enable. */
+#define LVT_MASKED    0x10000       /* Interrupt masked. */
+#define LVT_PERIODIC  0x20000       /* Timer: reload on reaching zero. */
+#define TDCR_DIV16    0x3           /* Timer counts at bus clock / 16. */
+
+/* Interrupt command register bits. */
+#define ICR_INIT      0x00500       /* INIT delivery mode. */
+#define ICR_STARTUP   0x00600       /* Startup IPI delivery mode. */
+#define ICR_PENDING   0x01000       /* Delivery status. */
+#define ICR_ASSERT    0x04000       /* Level assert. */
+#define ICR_LEVEL     0x08000       /* Level triggered. */
+#define ICR_OTHERS    0xc0000       /* Shorthand: all excluding self. */
+
+/* Registers, mapped uncached into the kernel address space. */
+static volatile uint32_t *lapic;
+
+static uint32_t lapic_read (int reg);
+static void lapic_write (int reg, uint32_t value);
+static void lapic_send (uint32_t hi, uint32_t lo);
+static intr_handler_func lapic_spurious;
+
+/* Maps and enables the bootstrap processor's local APIC, if that
+   has not been done yet.  Returns false if the CPU has no local
+   APIC. */
+bool
+lapic_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	void *va;
+
+	if (lapic != NULL)
+		return true;
+
+	/* CPUID.01H:EDX[9] says whether there is a local APIC. */
+	asm volatile ("cpuid"
+			: "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+	if (!(edx & (1 << 9)))
+		return false;
+
+	va = mmio_map (read_msr (MSR_APIC_BASE) & 0xffffff000ULL);
+	if (va == NULL)
+		return false;
+	lapic = va;
+	intr_register_int (LAPIC_SPURIOUS_VEC, 0, INTR_OFF, lapic_spurious,
+			"APIC Spurious");
+
+	/* Software-enable it.  Leave LINT0 and LINT1 as the BIOS set
+	   them up, so that PIC interrupts keep reaching us. */
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+	lapic_write (LAPIC_TPR, 0);
+	return true;
+}
+
+/* Enables the running secondary CPU's local APIC.  Only the
+   bootstrap processor takes PIC interrupts, so both local
+   interrupt pins are masked. */
+void
+lapic_init_ap (void) {
+	ASSERT (lapic != NULL);
+
+	write_msr (MSR_APIC_BASE, read_msr (MSR_APIC_BASE) | APIC_BASE_ENABLE);
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+	lapic_write (LAPIC_LINT0, LVT_MASKED);
+	lapic_write (LAPIC_LINT1, LVT_MASKED);
+	lapic_write (LAPIC_ESR, 0);
+	lapic_write (LAPIC_TPR, 0);
+}
+
+/* Returns the running CPU's local APIC ID. */
+uint8_t
+lapic_id (void) {
+	return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Acknowledges the interrupt being serviced. */
+void
+lapic_eoi (void) {
+	lapic_write (LAPIC_EOI, 0);
+}
+
+/* Sends interrupt VEC to the CPU whose local APIC ID is
+   APIC_ID. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec) {
+	lapic_send ((uint32_t) apic_id << 24, vec);
+}
+
+/* Sends interrupt VEC to every CPU but this one. */
+void
+lapic_send_ipi_others (uint8_t vec) {
+	lapic_send (0, ICR_OTHERS | vec);
+}
+
+/* Starts the secondary CPU with local APIC ID APIC_ID executing
+   in real mode at physical address ENTRY, which must be page
+   aligned and below 1 MB.  This is the INIT-SIPI-SIPI sequence
+   from [IA32-v3a] 8.4.4.1 "Typical BSP Initialization Sequence".
+   Interrupts must be on, because it sleeps. */
+void
+lapic_start_ap (uint8_t apic_id, uint64_t entry) {
+	uint32_t dest = (uint32_t) apic_id << 24;
+
+	ASSERT (entry % PGSIZE == 0 && entry < 0x100000);
+
+	lapic_send (dest, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+	timer_usleep (200);
+	lapic_send (dest, ICR_INIT | ICR_LEVEL);
+	timer_msleep (10);
+
+	for (int i = 0; i < 2; i++) {
+		lapic_send (dest, ICR_STARTUP | (entry >> 12));
+		timer_usleep (200);
+	}
+}
+
+/* Starts the running CPU's timer counting down from COUNT, at the
+   bus clock divided by 16.  In MODE LAPIC_TIMER_PERIODIC it
+   raises LAPIC_TIMER_VEC every COUNT counts; in
+   LAPIC_TIMER_ONESHOT, once.  LAPIC_TIMER_MASKED counts down once
+   without raising anything, for measuring the timer's rate. */
+void
+lapic_timer_start (uint32_t count, enum lapic_timer_mode mode) {
+	static const uint32_t lvt[] = {
+		[LAPIC_TIMER_ONESHOT] = LAPIC_TIMER_VEC,
+		[LAPIC_TIMER_PERIODIC] = LVT_PERIODIC | LAPIC_TIMER_VEC,
+		[LAPIC_TIMER_MASKED] = LVT_MASKED | LAPIC_TIMER_VEC,
+	};
+
+	ASSERT (lapic != NULL);
+	lapic_write (LAPIC_TDCR, TDCR_DIV16);
+	lapic_write (LAPIC_TIMER, lvt[mode]);
+	lapic_write (LAPIC_TICR, count);
+}
+
+/* Stops the running CPU's timer. */
+void
+lapic_timer_stop (void) {
+	lapic_write (LAPIC_TIMER, LVT_MASKED | LAPIC_TIMER_VEC);
+	lapic_write (LAPIC_TICR, 0);
+}
+
+/* Returns the running CPU's timer's current count. */
+uint32_t
+lapic_timer_count (void) {
+	return lapic_read (LAPIC_TCCR);
+}
+
+/* Spurious interrupt from the local APIC.  It must not be
+   acknowledged. */
+static void
+lapic_spurious (struct intr_frame *f UNUSED) {
+}
+
+static uint32_t
+lapic_read (int reg) {
+	return lapic[reg / 4];
+}
+
+static void
+lapic_write (int reg, uint32_t value) {
+	lapic[reg / 4] = value;
+	/* Wait for the write to finish, by reading. */
+	(void) lapic[LAPIC_ID / 4];
+}
+
+/* Writes HI and LO to the interrupt command register, which
+   sends the IPI, and waits for it to be delivered. */
+static void
+lapic_send (uint32_t hi, uint32_t lo) {
+	enum intr_level old_level = intr_disable ();
+
+	ASSERT (lapic != NULL);
+	lapic_write (LAPIC_ICRHI, hi);
+	lapic_write (LAPIC_ICRLO, lo);
+	while (lapic_read (LAPIC_ICRLO) & ICR_PENDING)
+		asm volatile ("pause");
+	intr_set_level (old_level);
+}
@@ -0,0 +1,198 @@
+#include "threads/lockstat.h"
+#ifdef LOCKSTAT
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/spinlock.h"
+
+/* Maximum number of lock classes.  Classes registered beyond this
+   are all counted under `overflow'. */
+#define LOCKSTAT_CLASSES 256
+
+/* Number of waiting call sites printed per class. */
+#define LOCKSTAT_PRINT_SITES 4
+
+/* Registry of lock classes. */
+static struct lockstat classes[LOCKSTAT_CLASSES];
+static size_t class_cnt;
+static struct spinlock registry_lock = SPINLOCK_INITIALIZER;
+static struct lockstat overflow = { .name = "(other)" };
+
+static void atomic_max (uint64_t *, uint64_t);
+static void count_site (struct lockstat *, void *site, uint64_t wait_ns);
+static void print_class (const struct lockstat *);
+
+/* Returns the class for locks named NAME or, if NAME is null, for
+   unnamed locks initialized at INIT_SITE, creating it if there is
+   none yet. */
+struct lockstat *
+lockstat_register (const char *name, void *init_site) {
+	struct lockstat *ls = NULL;
+	enum intr_level old_level;
+	size_t i;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&registry_lock);
+	for (i = 0; i < class_cnt && ls == NULL; i++)
+		if (name != NULL
+				? classes[i].name != NULL && !strcmp (classes[i].name, name)
+				: classes[i].name == NULL && classes[i].init_site == init_site)
+			ls = &classes[i];
+	if (ls == NULL) {
+		if (class_cnt < LOCKSTAT_CLASSES) {
+			ls = &classes[class_cnt++];
+			ls->name = name;
+			ls->init_site = init_site;
+		} else
+			ls = &overflow;
+	}
+	spinlock_release (&registry_lock);
+	intr_set_level (old_level);
+	return ls;
+}
+
+/* Records that a lock of class LS was acquired from call site
+   SITE, having been asked for at time START, and whether the
+   caller had to wait for it.  Returns the current time, which the
+   caller passes to lockstat_released() on release. */
+uint64_t
+lockstat_acquired (struct lockstat *ls, uint64_t start, bool contended,
+		void *site) {
+	uint64_t now = lockstat_now ();
+
+	__atomic_add_fetch (&ls->acquired, 1, __ATOMIC_RELAXED);
+	if (contended) {
+		uint64_t wait_ns = now - start;
+
+		__atomic_add_fetch (&ls->contended, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch (&ls->wait_ns, wait_ns, __ATOMIC_RELAXED);
+		atomic_max (&ls->wait_max_ns, wait_ns);
+		count_site (ls, site, wait_ns);
+	}
+	return now;
+}
+
+/* Records that a lock of class LS, acquired at ACQUIRED_AT, was
+   released. */
+void
+lockstat_released (struct lockstat *ls, uint64_t acquired_at) {
+	uint64_t hold_ns = lockstat_now () - acquired_at;
+
+	__atomic_add_fetch (&ls->hold_ns, hold_ns, __ATOMIC_RELAXED);
+	atomic_max (&ls->hold_max_ns, hold_ns);
+}
+
+/* Prints the statistics of every class that has been acquired,
+   most waited-for first, with the call sites that waited most. */
+void
+lockstat_print (void) {
+	uint64_t printed[DIV_ROUND_UP (LOCKSTAT_CLASSES, 64)];
+	size_t cnt = __atomic_load_n (&class_cnt, __ATOMIC_ACQUIRE);
+	size_t i;
+
+	memset (printed, 0, sizeof printed);
+	printf ("Lock statistics (times in us):\n");
+	printf ("  %-24s %10s %10s %10s %8s %10s %8s\n", "class", "acquired",
+			"contended", "wait", "max", "hold", "max");
+	for (;;) {
+		const struct lockstat *top = NULL;
+		size_t top_idx = 0;
+
+		for (i = 0; i < cnt; i++)
+			if (!(printed[i / 64] & (1ULL << (i % 64)))
+					&& classes[i].acquired > 0
+					&& (top == NULL || classes[i].wait_ns > top->wait_ns)) {
+				top = &classes[i];
+				top_idx = i;
+			}
+		if (top == NULL)
+			break;
+		printed[top_idx / 64] |= 1ULL << (top_idx % 64);
+		print_class (top);
+	}
+	if (overflow.acquired > 0)
+		print_class (&overflow);
+}
+
+/* Zeroes all statistics, keeping the classes. */
+void
+lockstat_reset (void) {
+	size_t cnt = __atomic_load_n (&class_cnt, __ATOMIC_ACQUIRE);
+	size_t i;
+
+	for (i = 0; i <= cnt; i++) {
+		struct lockstat *ls = i < cnt ? &classes[i] : &overflow;
+
+		ls->acquired = ls->contended = 0;
+		ls->wait_ns = ls->wait_max_ns = 0;
+		ls->hold_ns = ls->hold_max_ns = 0;
+		memset (ls->sites, 0, sizeof ls->sites);
+	}
+}
+
+/* Raises *P to V if V is greater. */
+static void
+atomic_max (uint64_t *p, uint64_t v) {
+	uint64_t old = __atomic_load_n (p, __ATOMIC_RELAXED);
+
+	while (v > old && !__atomic_compare_exchange_n (p, &old, v, true,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		continue;
+}
+
+/* Adds a wait of WAIT_NS from SITE to LS's site table, claiming a
+   free slot for SITE if it has none.  Once all slots are taken,
+   waits from new sites are not broken down. */
+static void
+count_site (struct lockstat *ls, void *site, uint64_t wait_ns) {
+	int i;
+
+	for (i = 0; i < LOCKSTAT_SITES; i++) {
+		struct lockstat_site *s = &ls->sites[i];
+		void *cur = __atomic_load_n (&s->site, __ATOMIC_RELAXED);
+
+		if (cur == NULL
+				&& __atomic_compare_exchange_n (&s->site, &cur, site, false,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			cur = site;
+		if (cur == site) {
+			__atomic_add_fetch (&s->cnt, 1, __ATOMIC_RELAXED);
+			__atomic_add_fetch (&s->wait_ns, wait_ns, __ATOMIC_RELAXED);
+			return;
+		}
+	}
+}
+
+/* Prints one line for LS, then its top waiting call sites. */
+static void
+print_class (const struct lockstat *ls) {
+	struct lockstat_site sites[LOCKSTAT_SITES];
+	char name[32];
+	int i, j;
+
+	if (ls->name != NULL)
+		strlcpy (name, ls->name, sizeof name);
+	else
+		snprintf (name, sizeof name, "lock@%p", ls->init_site);
+	printf ("  %-24s %10"PRIu64" %10"PRIu64" %10"PRIu64" %8"PRIu64
+			" %10"PRIu64" %8"PRIu64"\n",
+			name, ls->acquired, ls->contended, ls->wait_ns / 1000,
+			ls->wait_max_ns / 1000, ls->hold_ns / 1000, ls->hold_max_ns / 1000);
+
+	/* Insertion sort by time waited, most first. */
+	memcpy (sites, ls->sites, sizeof sites);
+	for (i = 1; i < LOCKSTAT_SITES; i++)
+		for (j = i; j > 0 && sites[j].wait_ns > sites[j - 1].wait_ns; j--) {
+			struct lockstat_site tmp = sites[j];
+			sites[j] = sites[j - 1];
+			sites[j - 1] = tmp;
+		}
+	for (i = 0; i < LOCKSTAT_PRINT_SITES && sites[i].site != NULL; i++)
+		printf ("    waited at %p: %"PRIu64" times, %"PRIu64" us\n",
+				sites[i].site, sites[i].cnt, sites[i].wait_ns / 1000);
+}
+
+#endif /* LOCKSTAT */
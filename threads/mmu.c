@@ -281,7 +281,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		if (dirty)
 			*pte |= PTE_D;
 		else
-			*pte &= ~(uint32_t) PTE_D;
+			*pte &= ~(uint64_t) PTE_D;
 
 		if (rcr3 () == vtop (pml4))
 			invlpg ((uint64_t) vpage);
@@ -307,9 +307,80 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		if (accessed)
 			*pte |= PTE_A;
 		else
-			*pte &= ~(uint32_t) PTE_A;
+			*pte &= ~(uint64_t) PTE_A;
 
 		if (rcr3 () == vtop (pml4))
 			invlpg ((uint64_t) vpage);
 	}
 }
+
+/* Maps the page of device registers at physical address PA,
+   uncached, into the kernel's address space at ptov (PA) and
+   returns that address, or a null pointer if memory for the page
+   tables is short.  Device registers lie above the top of RAM,
+   outside the range paging_init() maps.  The page table pages
+   hang off base_pml4's kernel half, which every process page
+   table shares. */
+void *
+mmio_map (uint64_t pa) {
+	uint64_t page = pa & ~(uint64_t) PGMASK;
+	void *va = ptov (page);
+	uint64_t *pte = pml4e_walk (base_pml4, (uint64_t) va, 1);
+
+	if (pte == NULL)
+		return NULL;
+	*pte = page | PTE_P | PTE_W | PTE_PCD | PTE_PWT;
+	invlpg ((uint64_t) va);
+	return va;
+}
+
+/* Maps kernel virtual page KVA, which must lie outside the range
+   paging_init() maps, to the frame at kernel virtual address
+   KPAGE.  Like mmio_map(), it goes in base_pml4's kernel half,
+   so every process page table sees it.  KVA must not already be
+   mapped.  Returns true if successful, false if memory for the
+   page tables is short. */
+bool
+kern_set_page (void *kva, void *kpage) {
+	uint64_t *pte;
+
+	ASSERT (pg_ofs (kva) == 0);
+	ASSERT (pg_ofs (kpage) == 0);
+	ASSERT (is_kernel_vaddr (kva));
+
+	pte = pml4e_walk (base_pml4, (uint64_t) kva, 1);
+	if (pte == NULL)
+		return false;
+	ASSERT (!(*pte & PTE_P));
+	*pte = vtop (kpage) | PTE_P | PTE_W;
+	return true;
+}
+
+/* Returns the kernel virtual address, in the range paging_init()
+   maps, of the frame that kernel virtual page KVA is mapped to by
+   kern_set_page(), or a null pointer if KVA is unmapped. */
+void *
+kern_get_page (const void *kva) {
+	uint64_t *pte = pml4e_walk (base_pml4, (uint64_t) kva, 0);
+
+	if (pte != NULL && (*pte & PTE_P))
+		return ptov (PTE_ADDR (*pte));
+	return NULL;
+}
+
+/* Removes the mapping of kernel virtual page KVA made by
+   kern_set_page() and returns the frame it mapped to, as
+   kern_get_page() would.  Only this CPU's TLB is flushed; see
+   smp_flush_tlb(). */
+void *
+kern_clear_page (void *kva) {
+	uint64_t *pte = pml4e_walk (base_pml4, (uint64_t) kva, 0);
+	void *kpage;
+
+	ASSERT (pte != NULL && (*pte & PTE_P));
+
+	kpage = ptov (PTE_ADDR (*pte));
+	*pte = 0;
+	invlpg ((uint64_t) kva);
+	return kpage;
+}
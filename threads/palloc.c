@@ -2,13 +2,17 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -24,13 +28,71 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  A free block of order K is 2**K pages whose first
+   page index, counted from the pool's base, is a multiple of 2**K.
+   It sits on the pool's free_lists[K] through a list_elem kept in
+   its first page.  The two halves of a block of order K + 1 are
+   "buddies", differing only in bit K of their index, and are
+   merged back together as soon as both are free.  Allocating or
+   freeing a block therefore takes O(MAX_ORDER) steps, whatever the
+   size of the pool and however fragmented it is. */
+
+/* Largest block order: 2**MAX_ORDER pages, or 4 MB. */
+#define MAX_ORDER 10
+
+/* Per-CPU page caches.
+
+   Single pages, by far the most common request, go through a small
+   stack of free pages ("magazine") that each CPU keeps for each
+   pool.  Only its own CPU touches a magazine, with interrupts off,
+   so this path takes no lock; when the pool runs dry, the other
+   CPUs are asked by IPI to empty theirs.  The top of the stack
+   holds the most recently freed pages, which are likely still in
+   the CPU's caches and are handed out first.  An empty magazine is
+   refilled with PCP_BATCH pages, and a full one sends its
+   PCP_BATCH coldest pages back to the buddy allocator, both in a
+   single trip to the pool lock.  Pages in a magazine still count
+   as used in the pool's bitmap. */
+#define PCP_HIGH 64                     /* Magazine capacity. */
+#define PCP_BATCH 16                    /* Pages moved per refill or drain. */
+
+/* Pre-zeroed pages.
+
+   A PAL_ZERO request for a single page is served, when possible,
+   from a stash of pages that the idle thread zeroed ahead of time
+   (see palloc_zero_idle()), instead of clearing the page on the
+   caller's time.  Each pool stashes up to ZERO_HIGH such pages;
+   they count as used, and are given back if memory runs short. */
+#define ZERO_HIGH 32
+
+/* One CPU's magazine for one pool. */
+struct page_cache {
+	size_t cnt;                     /* Number of pages in pages[]. */
+	void *pages[PCP_HIGH];          /* Free pages, hottest last. */
+	uint64_t allocs, frees;         /* Pages handed out and taken back. */
+	uint64_t refills, drains;       /* Trips to the buddy allocator. */
+};
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct spinlock lock;           /* Mutual exclusion. */
+	struct bitmap *used_map;        /* Bitmap of pages in use. */
+#ifndef NDEBUG
+	struct bitmap *cached_map;      /* Bitmap of pages in magazines. */
+#endif
 	uint8_t *base;                  /* Base of pool. */
+	uint8_t *free_order;            /* Per page: 1 + order if it heads a
+	                                   free block, otherwise 0. */
+	struct list free_lists[MAX_ORDER + 1]; /* Free blocks by order. */
+	struct page_cache caches[CPU_MAX];     /* Per-CPU page caches. */
+
+	struct spinlock zero_lock;      /* Protects the members below. */
+	size_t zeroed_cnt;              /* Number of pages in zeroed[]. */
+	void *zeroed[ZERO_HIGH];        /* Pre-zeroed pages. */
+	uint64_t zero_hits, zero_misses;/* PAL_ZERO pages found zeroed or not. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +104,20 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void buddy_init (struct pool *);
+static bool buddy_alloc (struct pool *, size_t page_cnt, size_t *page_idx);
+static bool pool_alloc (struct pool *, size_t page_cnt, size_t *page_idx);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void buddy_free_block (struct pool *, size_t page_idx, int order);
+static int buddy_order (size_t page_cnt);
+static void buddy_take (struct pool *, size_t page_idx, size_t page_cnt);
+static void *pcp_get (struct pool *);
+static void pcp_put (struct pool *, void *page);
+static void pcp_drain (struct pool *, struct page_cache *, size_t page_cnt);
+static void pcp_drain_cpu (void *pool);
+static void pcp_drain_all (struct pool *);
+static void *zeroed_get (struct pool *, bool zero);
+static void zeroed_drain (struct pool *);
 
 /* multiboot info */
 struct multiboot_info {
@@ -232,6 +308,9 @@ split:
 			}
 		}
 	}
+
+	buddy_init (&kernel_pool);
+	buddy_init (&user_pool);
 }
 
 /* Initializes the page allocator and get the memory size */
@@ -262,16 +341,42 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	enum intr_level old_level;
+	size_t page_idx;
+	void *pages = NULL;
+	bool success;
 
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
-	void *pages;
+	if (page_cnt == 0)
+		return NULL;
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+	if (page_cnt == 1) {
+		if (flags & PAL_ZERO) {
+			pages = zeroed_get (pool, true);
+			if (pages != NULL)
+				return pages;
+		}
+		pages = pcp_get (pool);
+		if (pages == NULL)
+			pages = zeroed_get (pool, false);
+		if (pages == NULL) {
+			/* The free pages may all sit in other CPUs' caches. */
+			pcp_drain_all (pool);
+			pages = pcp_get (pool);
+		}
+	} else {
+		success = pool_alloc (pool, page_cnt, &page_idx);
+		if (!success) {
+			/* Cached pages may be what keeps a block from
+			   forming. */
+			pcp_drain_all (pool);
+			old_level = intr_disable ();
+			zeroed_drain (pool);
+			intr_set_level (old_level);
+			success = pool_alloc (pool, page_cnt, &page_idx);
+		}
+		if (success)
+			pages = pool->base + PGSIZE * page_idx;
+	}
 
 	if (pages) {
 		if (flags & PAL_ZERO)
@@ -301,6 +406,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) {
 	struct pool *pool;
 	size_t page_idx;
+	enum intr_level old_level;
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
@@ -316,10 +422,29 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 	page_idx = pg_no (pages) - pg_no (pool->base);
 
 #ifndef NDEBUG
+	/* A single page goes to a magazine without the pool lock, so
+	   it is checked here that it was neither free nor cached. */
+	if (page_cnt == 1) {
+		ASSERT (bitmap_test (pool->used_map, page_idx));
+		ASSERT (!bitmap_test (pool->cached_map, page_idx));
+	}
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
+	if (page_cnt == 1) {
+		pcp_put (pool, pages);
+		return;
+	}
+
+	/* The scheduler frees dying threads with interrupts off, so
+	   the pools are guarded by spin locks rather than sleeping
+	   locks. */
+	old_level = intr_disable ();
+	spinlock_acquire (&pool->lock);
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	buddy_free (pool, page_idx, page_cnt);
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -328,6 +453,119 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Tries to extend the PAGE_CNT pages starting at PAGES, which
+   must be in use, to NEW_CNT pages in place, by taking the pages
+   that follow them.  Returns true if successful, false if any of
+   those pages is in use or past the end of the pool.  The new
+   pages are not zeroed. */
+bool
+palloc_grow (void *pages, size_t page_cnt, size_t new_cnt) {
+	struct pool *pool;
+	size_t page_idx;
+	enum intr_level old_level;
+	bool success;
+
+	ASSERT (pg_ofs (pages) == 0);
+	ASSERT (new_cnt >= page_cnt);
+
+	if (page_from_pool (&kernel_pool, pages))
+		pool = &kernel_pool;
+	else if (page_from_pool (&user_pool, pages))
+		pool = &user_pool;
+	else
+		NOT_REACHED ();
+
+	page_idx = pg_no (pages) - pg_no (pool->base) + page_cnt;
+	if (page_idx + (new_cnt - page_cnt) > bitmap_size (pool->used_map))
+		return false;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&pool->lock);
+	success = bitmap_none (pool->used_map, page_idx, new_cnt - page_cnt);
+	if (success) {
+		buddy_take (pool, page_idx, new_cnt - page_cnt);
+		bitmap_set_multiple (pool->used_map, page_idx, new_cnt - page_cnt,
+				true);
+	}
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
+	return success;
+}
+
+/* Called by the idle thread, with interrupts on, while it has
+   nothing else to do.  Zeroes one free page for the stash of
+   pre-zeroed pages of a pool that is below its watermark.  Returns
+   true if it did, false if every stash is full or no page is
+   free. */
+bool
+palloc_zero_idle (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+	enum intr_level old_level;
+	size_t i;
+
+	for (i = 0; i < 2; i++) {
+		struct pool *pool = pools[i];
+		bool full;
+		void *page;
+
+		if (__atomic_load_n (&pool->zeroed_cnt, __ATOMIC_RELAXED) >= ZERO_HIGH)
+			continue;
+		page = pcp_get (pool);
+		if (page == NULL)
+			continue;
+		memset (page, 0, PGSIZE);
+
+		/* Another CPU's idle thread may have filled it meanwhile. */
+		old_level = intr_disable ();
+		spinlock_acquire (&pool->zero_lock);
+		full = pool->zeroed_cnt >= ZERO_HIGH;
+		if (!full)
+			pool->zeroed[pool->zeroed_cnt++] = page;
+		spinlock_release (&pool->zero_lock);
+		intr_set_level (old_level);
+		if (full)
+			pcp_put (pool, page);
+		return true;
+	}
+	return false;
+}
+
+/* Stores the first page of the user pool in *BASE and the number
+   of pages it spans in *PAGE_CNT, so that the frame table can
+   have an entry for each of them. */
+void
+palloc_user_pool (void **base, size_t *page_cnt) {
+	*base = user_pool.base;
+	*page_cnt = bitmap_size (user_pool.used_map);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+	const char *names[] = { "kernel", "user" };
+	size_t i;
+	int cpu;
+
+	for (i = 0; i < 2; i++) {
+		uint64_t allocs = 0, frees = 0, refills = 0, drains = 0;
+
+		printf ("Palloc: %s zeroed pages: %"PRIu64" hits, %"PRIu64" misses\n",
+				names[i], pools[i]->zero_hits, pools[i]->zero_misses);
+
+		for (cpu = 0; cpu < CPU_MAX; cpu++) {
+			struct page_cache *pc = &pools[i]->caches[cpu];
+			allocs += pc->allocs;
+			frees += pc->frees;
+			refills += pc->refills;
+			drains += pc->drains;
+		}
+		printf ("Palloc: %s page cache: %"PRIu64" allocs, %"PRIu64" frees, "
+				"%"PRIu64" refills, %"PRIu64" drains\n",
+				names[i], allocs, frees, refills, drains);
+	}
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -336,8 +574,11 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t order_pages = DIV_ROUND_UP (pgcnt, PGSIZE) * PGSIZE;
+	int order;
 
-	lock_init(&p->lock);
+	spinlock_init (&p->lock);
+	spinlock_init (&p->zero_lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
 
@@ -345,6 +586,23 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 	bitmap_set_all(p->used_map, true);
 
 	*bm_base += bm_pages;
+
+	/* The buddy allocator's per-page orders follow the bitmap.
+	   buddy_init() fills the free lists once the usable pages are
+	   known. */
+	p->free_order = *bm_base;
+	memset (p->free_order, 0, pgcnt);
+	for (order = 0; order <= MAX_ORDER; order++)
+		list_init (&p->free_lists[order]);
+	*bm_base += order_pages;
+
+#ifndef NDEBUG
+	/* Debug builds also track which pages sit in magazines, to
+	   catch double frees of single pages. */
+	p->cached_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	bitmap_set_all (p->cached_map, false);
+	*bm_base += bm_pages;
+#endif
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -356,3 +614,311 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Puts every page of POOL that populate_pools() found usable on
+   POOL's free lists, in blocks as large as their alignment
+   allows. */
+static void
+buddy_init (struct pool *pool) {
+	size_t page_cnt = bitmap_size (pool->used_map);
+	size_t start = 0;
+
+	while (start < page_cnt) {
+		size_t end;
+
+		start = bitmap_scan (pool->used_map, start, 1, false);
+		if (start == BITMAP_ERROR)
+			break;
+		for (end = start; end < page_cnt
+				&& !bitmap_test (pool->used_map, end); end++)
+			continue;
+		buddy_free (pool, start, end - start);
+		start = end;
+	}
+}
+
+/* Returns the order of the smallest block that holds PAGE_CNT
+   pages. */
+static int
+buddy_order (size_t page_cnt) {
+	int order = 0;
+
+	while (((size_t) 1 << order) < page_cnt)
+		order++;
+	return order;
+}
+
+/* Takes PAGE_CNT contiguous pages from POOL's free lists and stores
+   the index of the first in *PAGE_IDX.  The block is split down to
+   the order PAGE_CNT needs, and the pages past PAGE_CNT are given
+   back.  Returns false if no block is large enough, which includes
+   any request for more than 2**MAX_ORDER pages.  POOL's lock must
+   be held. */
+static bool
+buddy_alloc (struct pool *pool, size_t page_cnt, size_t *page_idx) {
+	int want = buddy_order (page_cnt);
+	int order;
+	size_t idx;
+
+	if (want > MAX_ORDER)
+		return false;
+	for (order = want; order <= MAX_ORDER; order++)
+		if (!list_empty (&pool->free_lists[order]))
+			break;
+	if (order > MAX_ORDER)
+		return false;
+
+	idx = pg_no (list_pop_front (&pool->free_lists[order]))
+		- pg_no (pool->base);
+	pool->free_order[idx] = 0;
+	/* Return the upper halves, largest first. */
+	while (order > want) {
+		order--;
+		buddy_free_block (pool, idx + ((size_t) 1 << order), order);
+	}
+	if (page_cnt < (size_t) 1 << want)
+		buddy_free (pool, idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+
+	*page_idx = idx;
+	return true;
+}
+
+/* Takes the PAGE_CNT pages starting at PAGE_IDX, which must all
+   be free, off POOL's free lists.  The free blocks that hold them
+   are split, and their pages outside the range given back.
+   POOL's lock must be held. */
+static void
+buddy_take (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t end = page_idx + page_cnt;
+	size_t idx = page_idx;
+
+	while (idx < end) {
+		size_t start, block_end;
+		int order;
+
+		/* Find the free block that IDX is in. */
+		for (order = 0; order <= MAX_ORDER; order++) {
+			start = idx & ~(((size_t) 1 << order) - 1);
+			if (pool->free_order[start] == order + 1)
+				break;
+		}
+		ASSERT (order <= MAX_ORDER);
+
+		list_remove ((struct list_elem *) (pool->base + PGSIZE * start));
+		pool->free_order[start] = 0;
+		block_end = start + ((size_t) 1 << order);
+		if (start < page_idx)
+			buddy_free (pool, start, page_idx - start);
+		if (block_end > end)
+			buddy_free (pool, end, block_end - end);
+		idx = block_end;
+	}
+}
+
+/* Gives the PAGE_CNT pages starting at PAGE_IDX back to POOL's
+   free lists, as the fewest aligned blocks that cover them.
+   POOL's lock must be held, or POOL must not be in use yet. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order < MAX_ORDER
+				&& page_idx % ((size_t) 2 << order) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		buddy_free_block (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Puts the free block of order ORDER at PAGE_IDX on POOL's free
+   lists, first merging it with its buddy for as long as that is
+   free too. */
+static void
+buddy_free_block (struct pool *pool, size_t page_idx, int order) {
+	size_t page_cnt = bitmap_size (pool->used_map);
+
+	while (order < MAX_ORDER) {
+		size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+		if (buddy >= page_cnt || pool->free_order[buddy] != order + 1)
+			break;
+		list_remove ((struct list_elem *) (pool->base + PGSIZE * buddy));
+		pool->free_order[buddy] = 0;
+		if (buddy < page_idx)
+			page_idx = buddy;
+		order++;
+	}
+	pool->free_order[page_idx] = order + 1;
+	list_push_front (&pool->free_lists[order],
+			(struct list_elem *) (pool->base + PGSIZE * page_idx));
+}
+
+/* Returns a free page from POOL through the running CPU's page
+   cache, refilling the cache from the buddy allocator if it is
+   empty, or a null pointer if POOL is out of pages. */
+static void *
+pcp_get (struct pool *pool) {
+	enum intr_level old_level = intr_disable ();
+	struct page_cache *pc = &pool->caches[cpu_current ()->id];
+	void *page = NULL;
+
+	if (pc->cnt == 0) {
+		size_t page_idx;
+
+		pc->refills++;
+		spinlock_acquire (&pool->lock);
+		while (pc->cnt < PCP_BATCH && buddy_alloc (pool, 1, &page_idx)) {
+			ASSERT (!bitmap_test (pool->used_map, page_idx));
+			bitmap_mark (pool->used_map, page_idx);
+			pc->pages[pc->cnt++] = pool->base + PGSIZE * page_idx;
+		}
+		spinlock_release (&pool->lock);
+	}
+	if (pc->cnt > 0) {
+		page = pc->pages[--pc->cnt];
+		pc->allocs++;
+#ifndef NDEBUG
+		bitmap_reset (pool->cached_map, pg_no (page) - pg_no (pool->base));
+#endif
+	}
+	intr_set_level (old_level);
+	return page;
+}
+
+/* Returns PAGE, a single page of POOL, to the running CPU's page
+   cache, first making room by draining its coldest pages to the
+   buddy allocator if it is full. */
+static void
+pcp_put (struct pool *pool, void *page) {
+	enum intr_level old_level = intr_disable ();
+	struct page_cache *pc = &pool->caches[cpu_current ()->id];
+
+	if (pc->cnt == PCP_HIGH)
+		pcp_drain (pool, pc, PCP_BATCH);
+	pc->pages[pc->cnt++] = page;
+	pc->frees++;
+#ifndef NDEBUG
+	bitmap_mark (pool->cached_map, pg_no (page) - pg_no (pool->base));
+#endif
+	intr_set_level (old_level);
+}
+
+/* Gives the PAGE_CNT coldest pages in PC, the running CPU's page
+   cache for POOL, back to the buddy allocator.  Interrupts must be
+   off and POOL's lock not held. */
+static void
+pcp_drain (struct pool *pool, struct page_cache *pc, size_t page_cnt) {
+	size_t i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (pc == &pool->caches[cpu_current ()->id]);
+	ASSERT (page_cnt <= pc->cnt);
+
+	if (page_cnt == 0)
+		return;
+	pc->drains++;
+	spinlock_acquire (&pool->lock);
+	for (i = 0; i < page_cnt; i++) {
+		size_t page_idx = pg_no (pc->pages[i]) - pg_no (pool->base);
+
+		ASSERT (bitmap_test (pool->used_map, page_idx));
+		bitmap_reset (pool->used_map, page_idx);
+#ifndef NDEBUG
+		bitmap_reset (pool->cached_map, page_idx);
+#endif
+		buddy_free (pool, page_idx, 1);
+	}
+	spinlock_release (&pool->lock);
+	pc->cnt -= page_cnt;
+	memmove (pc->pages, pc->pages + page_cnt, pc->cnt * sizeof *pc->pages);
+}
+
+/* Gives every page in the running CPU's page cache for POOL_, a
+   struct pool, back to the buddy allocator.  Interrupts must be
+   off and the pool's lock not held.  Runs on the other CPUs as
+   pcp_drain_all()'s IPI handler. */
+static void
+pcp_drain_cpu (void *pool_) {
+	struct pool *pool = pool_;
+	struct page_cache *pc = &pool->caches[cpu_current ()->id];
+
+	pcp_drain (pool, pc, pc->cnt);
+}
+
+/* Gives every page in all of POOL's page caches back to the buddy
+   allocator.  Each CPU empties its own, the others by IPI, so that
+   no magazine is ever touched by another CPU.  With interrupts
+   off, when the other CPUs cannot be waited for, only the running
+   CPU's is emptied.  POOL's lock must not be held. */
+static void
+pcp_drain_all (struct pool *pool) {
+	enum intr_level old_level = intr_disable ();
+
+	pcp_drain_cpu (pool);
+	intr_set_level (old_level);
+	if (old_level == INTR_ON)
+		smp_call (pcp_drain_cpu, pool);
+}
+
+/* Takes PAGE_CNT contiguous pages from POOL's buddy allocator and
+   marks them used, storing the index of the first in *PAGE_IDX.
+   Returns false if no block is large enough. */
+static bool
+pool_alloc (struct pool *pool, size_t page_cnt, size_t *page_idx) {
+	enum intr_level old_level = intr_disable ();
+	bool success;
+
+	spinlock_acquire (&pool->lock);
+	success = buddy_alloc (pool, page_cnt, page_idx);
+	if (success) {
+		ASSERT (bitmap_none (pool->used_map, *page_idx, page_cnt));
+		bitmap_set_multiple (pool->used_map, *page_idx, page_cnt, true);
+	}
+	spinlock_release (&pool->lock);
+	intr_set_level (old_level);
+	return success;
+}
+
+/* Takes a page from POOL's stash of pre-zeroed pages.  If ZERO,
+   the caller asked for PAL_ZERO and a miss is counted.  Returns a
+   null pointer if the stash is empty. */
+static void *
+zeroed_get (struct pool *pool, bool zero) {
+	enum intr_level old_level = intr_disable ();
+	void *page = NULL;
+
+	spinlock_acquire (&pool->zero_lock);
+	if (pool->zeroed_cnt > 0)
+		page = pool->zeroed[--pool->zeroed_cnt];
+	if (zero) {
+		if (page != NULL)
+			pool->zero_hits++;
+		else
+			pool->zero_misses++;
+	}
+	spinlock_release (&pool->zero_lock);
+	intr_set_level (old_level);
+	return page;
+}
+
+/* Gives all of POOL's pre-zeroed pages back to the buddy
+   allocator.  Interrupts must be off and POOL's lock not held. */
+static void
+zeroed_drain (struct pool *pool) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&pool->zero_lock);
+	spinlock_acquire (&pool->lock);
+	while (pool->zeroed_cnt > 0) {
+		void *page = pool->zeroed[--pool->zeroed_cnt];
+		size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+		bitmap_reset (pool->used_map, page_idx);
+		buddy_free (pool, page_idx, 1);
+	}
+	spinlock_release (&pool->lock);
+	spinlock_release (&pool->zero_lock);
+}
@@ -0,0 +1,334 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   A slab is one page from the kernel pool.  It starts with a
+   struct slab, whose next[] array chains the slab's free objects
+   by index, followed by the objects themselves.  Keeping the free
+   chain outside the objects means that a free object keeps
+   whatever its constructor put there: the constructor runs once,
+   when its slab is created, and kmem_cache_free() expects the
+   object back in its constructed state.
+
+   The space left over at the end of a slab is used to "color"
+   it: successive slabs start their objects KMEM_COLOR bytes
+   further into the page, up to what the leftover allows, so that
+   the first objects of different slabs do not all compete for
+   the same CPU cache sets.
+
+   A cache's slabs are on one of three lists, by whether they
+   have free objects, used objects, or both.  Objects come from
+   partial slabs first, to let the others drain.  At most one
+   empty slab is kept; more go back to the page allocator.
+
+   Every slab and every cache magazine hold objects of a single
+   cache, so kmem_cache_of() can tell from the page an object is
+   in which cache it came from.  This is how free() handles
+   objects of the caches that back malloc(). */
+
+/* Magic number for detecting slab corruption.  Must differ from
+   malloc()'s ARENA_MAGIC, since both sit at the start of a page. */
+#define SLAB_MAGIC 0x51ab51ab
+
+#define KMEM_ALIGN 8                    /* Object alignment. */
+#define KMEM_COLOR 64                   /* Color step: a cache line. */
+#define KMEM_BATCH (KMEM_MAG_SIZE / 2)  /* Objects per refill or flush. */
+
+/* End of a slab's free chain. */
+#define SLAB_END UINT16_MAX
+
+/* A slab. */
+struct slab {
+	unsigned magic;                 /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;       /* Owning cache. */
+	struct list_elem elem;          /* In one of the cache's lists. */
+	uint8_t *objs;                  /* First object. */
+	size_t used_cnt;                /* Objects not in next[]'s chain. */
+	uint16_t free;                  /* First free object, or SLAB_END. */
+	uint16_t next[];                /* Next free object, by index. */
+};
+
+/* All caches, for kmem_print_stats(). */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+static struct spinlock all_caches_lock = SPINLOCK_INITIALIZER;
+
+static struct slab *slab_create (struct kmem_cache *);
+static void cache_refill (struct kmem_cache *, struct kmem_magazine *);
+static void cache_flush (struct kmem_cache *, struct kmem_magazine *,
+		size_t obj_cnt);
+
+/* Initializes C as a cache of objects SIZE bytes long, named NAME
+   in statistics.  If CTOR is nonnull, it is called on each object
+   once, when the object's slab is created, rather than on every
+   allocation; objects must then be freed in their constructed
+   state.
+
+   SIZE must leave room for at least one object in a page. */
+void
+kmem_cache_init (struct kmem_cache *c, const char *name, size_t size,
+		void (*ctor) (void *)) {
+	enum intr_level old_level;
+	size_t n, left;
+
+	ASSERT (c != NULL);
+	ASSERT (size > 0);
+
+	c->name = name;
+	c->size = ROUND_UP (size, KMEM_ALIGN);
+	c->ctor = ctor;
+
+	/* Fit as many objects, with their next[] entries, as we can. */
+	n = (PGSIZE - sizeof (struct slab)) / (c->size + sizeof (uint16_t));
+	while (n > 0 && ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+				KMEM_ALIGN) + n * c->size > PGSIZE)
+		n--;
+	ASSERT (n > 0 && n < SLAB_END);
+	c->obj_cnt = n;
+	c->obj_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+			KMEM_ALIGN);
+	left = PGSIZE - c->obj_ofs - n * c->size;
+	c->color_cnt = left / KMEM_COLOR + 1;
+
+	spinlock_init (&c->lock);
+	c->color_next = 0;
+	list_init (&c->partial);
+	list_init (&c->full);
+	list_init (&c->empty);
+	c->slab_cnt = c->slab_peak = 0;
+	memset (c->mags, 0, sizeof c->mags);
+
+	old_level = intr_disable ();
+	spinlock_acquire (&all_caches_lock);
+	list_push_back (&all_caches, &c->elem);
+	spinlock_release (&all_caches_lock);
+	intr_set_level (old_level);
+}
+
+/* Obtains and returns an object from cache C, or a null pointer
+   if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	enum intr_level old_level = intr_disable ();
+	struct kmem_magazine *m = &c->mags[cpu_current ()->id];
+	void *obj = NULL;
+
+	if (m->cnt == 0)
+		cache_refill (c, m);
+	if (m->cnt > 0) {
+		obj = m->objs[--m->cnt];
+		m->allocs++;
+	}
+	intr_set_level (old_level);
+	return obj;
+}
+
+/* Like kmem_cache_alloc(), but zeroes the object.  C must not
+   have a constructor. */
+void *
+kmem_cache_zalloc (struct kmem_cache *c) {
+	void *obj;
+
+	ASSERT (c->ctor == NULL);
+
+	obj = kmem_cache_alloc (c);
+	if (obj != NULL)
+		memset (obj, 0, c->size);
+	return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C, to C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	enum intr_level old_level;
+	struct kmem_magazine *m;
+
+	ASSERT (kmem_cache_of (obj) == c);
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs, unless
+	   it is supposed to stay constructed. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->size);
+#endif
+
+	old_level = intr_disable ();
+	m = &c->mags[cpu_current ()->id];
+	if (m->cnt == KMEM_MAG_SIZE)
+		cache_flush (c, m, KMEM_BATCH);
+	m->objs[m->cnt++] = obj;
+	m->frees++;
+	intr_set_level (old_level);
+}
+
+/* Returns the cache that OBJ was allocated from, or a null pointer
+   if OBJ, which must be the start of a malloc() or slab block, is
+   not in a slab. */
+struct kmem_cache *
+kmem_cache_of (const void *obj) {
+	const struct slab *s = pg_round_down (obj);
+
+	ASSERT (s != NULL);
+	if (s->magic != SLAB_MAGIC)
+		return NULL;
+	ASSERT ((size_t) ((const uint8_t *) obj - s->objs) % s->cache->size == 0);
+	return s->cache;
+}
+
+/* Returns the size of C's objects, which may be somewhat more
+   than was asked for in kmem_cache_init(). */
+size_t
+kmem_cache_size (const struct kmem_cache *c) {
+	return c->size;
+}
+
+/* Prints slab allocator statistics. */
+void
+kmem_print_stats (void) {
+	enum intr_level old_level = intr_disable ();
+	struct list_elem *e;
+
+	spinlock_acquire (&all_caches_lock);
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		uint64_t allocs = 0, frees = 0, refills = 0, flushes = 0;
+		int cpu;
+
+		for (cpu = 0; cpu < CPU_MAX; cpu++) {
+			allocs += c->mags[cpu].allocs;
+			frees += c->mags[cpu].frees;
+			refills += c->mags[cpu].refills;
+			flushes += c->mags[cpu].flushes;
+		}
+		if (allocs == 0)
+			continue;
+		printf ("Slab: %s: %zu-byte objects, %zu per slab, "
+				"%"PRIu64" in use, %zu slabs (peak %zu)\n",
+				c->name, c->size, c->obj_cnt, allocs - frees,
+				c->slab_cnt, c->slab_peak);
+		printf ("Slab: %s: %"PRIu64" allocs, %"PRIu64" frees, "
+				"%"PRIu64" refills, %"PRIu64" flushes\n",
+				c->name, allocs, frees, refills, flushes);
+	}
+	spinlock_release (&all_caches_lock);
+	intr_set_level (old_level);
+}
+
+/* Allocates and returns a new slab for C, with all of its objects
+   free and constructed, or a null pointer if no page is free.
+   Does not add it to any of C's lists. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s;
+	size_t color, i;
+
+	s = palloc_get_page (0);
+	if (s == NULL)
+		return NULL;
+
+	spinlock_acquire (&c->lock);
+	color = c->color_next;
+	c->color_next = (c->color_next + 1) % c->color_cnt;
+	spinlock_release (&c->lock);
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->objs = (uint8_t *) s + c->obj_ofs + color * KMEM_COLOR;
+	s->used_cnt = 0;
+	s->free = 0;
+	for (i = 0; i < c->obj_cnt; i++) {
+		s->next[i] = i + 1 < c->obj_cnt ? i + 1 : SLAB_END;
+		if (c->ctor != NULL)
+			c->ctor (s->objs + i * c->size);
+	}
+	return s;
+}
+
+/* Fills M, the running CPU's magazine for C, with KMEM_BATCH
+   objects from C's slabs, creating a slab if they run out.
+   Interrupts must be off. */
+static void
+cache_refill (struct kmem_cache *c, struct kmem_magazine *m) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	m->refills++;
+	spinlock_acquire (&c->lock);
+	while (m->cnt < KMEM_BATCH) {
+		struct list *from;
+		struct slab *s;
+
+		if (!list_empty (&c->partial))
+			from = &c->partial;
+		else if (!list_empty (&c->empty))
+			from = &c->empty;
+		else {
+			/* Create one without holding the lock. */
+			spinlock_release (&c->lock);
+			s = slab_create (c);
+			spinlock_acquire (&c->lock);
+			if (s == NULL)
+				break;
+			list_push_front (&c->empty, &s->elem);
+			if (++c->slab_cnt > c->slab_peak)
+				c->slab_peak = c->slab_cnt;
+			continue;
+		}
+
+		s = list_entry (list_front (from), struct slab, elem);
+		while (m->cnt < KMEM_BATCH && s->free != SLAB_END) {
+			m->objs[m->cnt++] = s->objs + s->free * c->size;
+			s->free = s->next[s->free];
+			s->used_cnt++;
+		}
+		list_remove (&s->elem);
+		list_push_front (s->free == SLAB_END ? &c->full : &c->partial,
+				&s->elem);
+	}
+	spinlock_release (&c->lock);
+}
+
+/* Gives the OBJ_CNT coldest objects in M, the running CPU's
+   magazine for C, back to their slabs.  Interrupts must be off. */
+static void
+cache_flush (struct kmem_cache *c, struct kmem_magazine *m, size_t obj_cnt) {
+	size_t i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (obj_cnt <= m->cnt);
+
+	m->flushes++;
+	spinlock_acquire (&c->lock);
+	for (i = 0; i < obj_cnt; i++) {
+		uint8_t *obj = m->objs[i];
+		struct slab *s = pg_round_down (obj);
+		size_t idx = (obj - s->objs) / c->size;
+
+		ASSERT (s->magic == SLAB_MAGIC && s->cache == c);
+		ASSERT (s->used_cnt > 0);
+
+		s->next[idx] = s->free;
+		s->free = idx;
+		list_remove (&s->elem);
+		if (--s->used_cnt > 0)
+			list_push_front (&c->partial, &s->elem);
+		else if (list_empty (&c->empty))
+			list_push_front (&c->empty, &s->elem);
+		else {
+			s->magic = 0;
+			c->slab_cnt--;
+			palloc_free_page (s);
+		}
+	}
+	spinlock_release (&c->lock);
+
+	m->cnt -= obj_cnt;
+	memmove (m->objs, m->objs + obj_cnt, m->cnt * sizeof *m->objs);
+}
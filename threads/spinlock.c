@@ -0,0 +1,63 @@
+#include "threads/spinlock.h"
+#include <debug.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+
+/* Initializes L as unlocked. */
+void
+spinlock_init (struct spinlock *l) {
+	ASSERT (l != NULL);
+
+	l->locked = 0;
+	l->cpu = -1;
+}
+
+/* Acquires L, spinning until it becomes available.  Interrupts
+   must be off and L must not already be held by this CPU. */
+void
+spinlock_acquire (struct spinlock *l) {
+	ASSERT (l != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!spinlock_held_by_current_cpu (l));
+
+	/* Test-and-test-and-set: only try the atomic exchange when the
+	   lock looks free, so waiters spin in their own cache. */
+	while (__atomic_exchange_n (&l->locked, 1, __ATOMIC_ACQUIRE))
+		while (l->locked)
+			asm volatile ("pause");
+	l->cpu = cpu_current ()->id;
+}
+
+/* Tries to acquire L without spinning.  Returns true if
+   successful, false if L is held.  Interrupts must be off. */
+bool
+spinlock_try_acquire (struct spinlock *l) {
+	ASSERT (l != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (__atomic_exchange_n (&l->locked, 1, __ATOMIC_ACQUIRE))
+		return false;
+	l->cpu = cpu_current ()->id;
+	return true;
+}
+
+/* Releases L, which must be held by this CPU.  L need not have
+   been acquired by the running thread: the scheduler acquires a
+   run queue lock in one thread and releases it in the next. */
+void
+spinlock_release (struct spinlock *l) {
+	ASSERT (spinlock_held_by_current_cpu (l));
+
+	l->cpu = -1;
+	__atomic_store_n (&l->locked, 0, __ATOMIC_RELEASE);
+}
+
+/* Returns true if this CPU holds L, false otherwise.  Interrupts
+   should be off, or the answer may be stale by the time it is
+   used. */
+bool
+spinlock_held_by_current_cpu (const struct spinlock *l) {
+	ASSERT (l != NULL);
+
+	return l->locked && l->cpu == cpu_current ()->id;
+}
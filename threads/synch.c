@@ -30,8 +30,68 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
+#include "threads/spinlock.h"
 #include "threads/thread.h"
 
+/* Priority inheritance.
+
+   A thread's priority is the highest of its own priority and the
+   priorities of the top waiters of the locks it holds.  Each
+   thread keeps the locks it holds on `held_locks', keyed by their
+   top waiter's priority, so that maximum is always at the front.
+
+   Whenever a lock's waiters change, or the priority of one of
+   them does, pi_update() re-keys the lock in its holder's list
+   and recomputes the holder's priority.  If that changed and the
+   holder is itself waiting for a lock, the same happens one level
+   up, and so on until some priority stays the same.  This works
+   in both directions, through chains of any depth, and touches
+   only the threads whose priority actually changes.
+
+   Rwlocks take part the same way, except that a rwlock held for
+   reading has many holders: each reader files the rwlock on its own
+   held_locks through a struct rwlock_hold, and rw_pi_update()
+   re-keys and updates all of them.
+
+   A thread waiting on a condition variable is re-keyed in the
+   condition's queue as well as in its own semaphore's.
+
+   Only locks that someone waits for are filed on held_locks
+   ("filed" says which).  The first waiter files the lock on its
+   holder's list, in pi_update().  A lock nobody waits for cannot
+   lend anyone priority, so taking and releasing it is left to the
+   spinlock of its semaphore alone; the same goes for rwlocks,
+   which have a spinlock of their own.
+
+   donation_lock protects the rest: every thread's held_locks,
+   wait_on_lock and wait_on_rwlock, the filing of locks and
+   rwlocks, and the wait queues of locks' semaphores and of
+   rwlocks.  A thread that is about to wait for a lock or rwlock
+   takes it, and so does a thread that holds a lock when it queues
+   on any semaphore, since pi_update() may have to re-key it
+   there.  Taken before any semaphore, rwlock or run queue lock.
+   None of this is used with the MLFQS, which ignores donation. */
+static struct spinlock donation_lock = SPINLOCK_INITIALIZER;
+
+static bool sema_wait (struct semaphore *, struct lock *);
+static void sema_post (struct semaphore *);
+static void lock_take_locked (struct lock *);
+static void held_file (struct thread *, struct plist_elem *, bool *filed,
+		int priority);
+static bool mutex_take (struct mutex *);
+static int lock_max_priority (struct lock *);
+static int inherited_priority (struct thread *);
+static void pi_update (struct lock *);
+static void pi_refresh (struct thread *);
+static int rw_max_priority (struct rwlock *);
+static void rw_pi_update (struct rwlock *);
+static void rw_wait (struct rwlock *, bool write);
+static void rw_wake (struct rwlock *);
+static void rw_add_reader (struct rwlock *, struct thread *);
+static void rw_set_writer (struct rwlock *, struct thread *);
+static void update_donation_locked (void);
+static void set_priority_locked (struct thread *, int priority);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -46,7 +106,8 @@ sema_init (struct semaphore *sema, unsigned value) {
 	ASSERT (sema != NULL);
 
 	sema->value = value;
-	list_init (&sema->waiters);
+	plist_init (&sema->waiters);
+	spinlock_init (&sema->lock);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -59,21 +120,82 @@ sema_init (struct semaphore *sema, unsigned value) {
    sema_down function. */
 void
 sema_down (struct semaphore *sema) {
+	sema_wait (sema, NULL);
+}
+
+/* Waits for SEMA's value to become positive and decrements it.
+   If LOCK is non-null, SEMA is LOCK's semaphore: while we wait,
+   our priority is inherited by LOCK's holder, and once we have
+   decremented SEMA we own LOCK.  Returns true if we had to wait.
+
+   Waiters are queued by priority.  Only lock holders receive
+   donations, so apart from lock waiters only they take
+   donation_lock here, and only once they find they must wait:
+   pi_update() then finds them either queued under their current
+   priority or not queued, and the semaphore stays valid while it
+   re-keys them.  Taking a lock that has no waiters does not need
+   donation_lock at all. */
+static bool
+sema_wait (struct semaphore *sema, struct lock *lock) {
+	struct thread *t = thread_current ();
+	bool donee = !thread_mlfqs && (lock != NULL || t->lock_cnt > 0);
+	bool slow = false, waited = false, contended = false;
 	enum intr_level old_level;
 
 	ASSERT (sema != NULL);
 	ASSERT (!intr_context ());
-	
-	struct thread *t = thread_current();
 
 	old_level = intr_disable ();
+	spinlock_acquire (&sema->lock);
+	if (sema->value == 0 && donee) {
+		/* We must wait.  donation_lock comes first. */
+		spinlock_release (&sema->lock);
+		spinlock_acquire (&donation_lock);
+		spinlock_acquire (&sema->lock);
+		slow = true;
+	}
 	while (sema->value == 0) {
-		list_push_back (&sema->waiters, &thread_current ()->elem);
-		//list_insert_ordered(&sema->waiters, &t->elem, cmp_thread_priority, NULL);
+		waited = true;
+		plist_insert (&sema->waiters, &t->wait_elem, t->priority);
+		t->wait_sema = sema;
+		/* sema_up() on another CPU may wake us between here and
+		   thread_block(); thread_block() then returns at once. */
+		spinlock_release (&sema->lock);
+		if (lock != NULL && slow) {
+			t->wait_on_lock = lock;
+			pi_update (lock);
+		}
+		if (slow)
+			spinlock_release (&donation_lock);
 		thread_block ();
+		if (slow)
+			spinlock_acquire (&donation_lock);
+		spinlock_acquire (&sema->lock);
 	}
 	sema->value--;
+	if (lock != NULL) {
+		/* Set under SEMA's lock, so that a waiter that comes after
+		   us finds us in pi_update(). */
+		lock->holder = t;
+		contended = !plist_empty (&sema->waiters);
+	}
+	spinlock_release (&sema->lock);
+	if (lock != NULL && !thread_mlfqs) {
+		if (slow)
+			// sema down이 끝나면, 현재 cur는 작업을 끝낸 것 이므로
+			// 기다리는 것이 없음.
+			t->wait_on_lock = NULL;
+		if (waited || contended) {
+			if (!slow)
+				spinlock_acquire (&donation_lock);
+			slow = true;
+			lock_take_locked (lock);
+		}
+	}
+	if (slow)
+		spinlock_release (&donation_lock);
 	intr_set_level (old_level);
+	return waited;
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -89,6 +211,7 @@ sema_try_down (struct semaphore *sema) {
 	ASSERT (sema != NULL);
 
 	old_level = intr_disable ();
+	spinlock_acquire (&sema->lock);
 	if (sema->value > 0)
 	{
 		sema->value--;
@@ -96,6 +219,7 @@ sema_try_down (struct semaphore *sema) {
 	}
 	else
 		success = false;
+	spinlock_release (&sema->lock);
 	intr_set_level (old_level);
 
 	return success;
@@ -109,18 +233,29 @@ void
 sema_up (struct semaphore *sema) {
 	enum intr_level old_level;
 
+	old_level = intr_disable ();
+	sema_post (sema);
+	preempt();
+	intr_set_level (old_level);
+}
+
+/* sema_up() without the check for preemption, for callers that
+   hold a spinlock.  Interrupts must be off. */
+static void
+sema_post (struct semaphore *sema) {
 	ASSERT (sema != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
 
-	old_level = intr_disable ();
+	spinlock_acquire (&sema->lock);
 	//sema->value++;
-	if (!list_empty (&sema->waiters)){
-		list_sort(&sema->waiters, cmp_thread_priority, NULL); // donate 받아서 순위가 변경된 상황 고려.
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-					struct thread, elem));
+	if (!plist_empty (&sema->waiters)){
+		struct thread *t = plist_entry (plist_pop_front (&sema->waiters),
+				struct thread, wait_elem);
+		t->wait_sema = NULL;
+		thread_unblock (t);
 	}
 	sema->value++;
-	preempt();
-	intr_set_level (old_level);
+	spinlock_release (&sema->lock);
 }
 
 static void sema_test_helper (void *sema_);
@@ -178,12 +313,31 @@ lock_init (struct lock *lock) {
 	ASSERT (lock != NULL);
 
 	lock->holder = NULL;
+	lock->filed = false;
+	sema_init (&lock->semaphore, 1);
+#ifdef LOCKSTAT
+	lock->stat = lockstat_register (NULL, __builtin_return_address (0));
+#endif
+}
+
+/* Initializes LOCK like lock_init().  With LOCKSTAT, its
+   statistics are kept under NAME, together with those of all other
+   locks of that name. */
+void
+lock_init_named (struct lock *lock, const char *name UNUSED) {
+	ASSERT (lock != NULL);
+
+	lock->holder = NULL;
+	lock->filed = false;
 	sema_init (&lock->semaphore, 1);
+#ifdef LOCKSTAT
+	lock->stat = lockstat_register (name, NULL);
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
-   thread.
+   thread.  While we wait, LOCK's holder inherits our priority.
 
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
@@ -195,28 +349,15 @@ lock_acquire (struct lock *lock) {
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	struct thread *cur = thread_current();
-
-	if (thread_mlfqs) {
-		if (lock->holder) {
-			cur->wait_on_lock = lock;
-		}
-		sema_down (&lock->semaphore); // mlfqs면 도네이트 안하고 바로 리턴해야함
-		lock->holder = cur;
-		lock->holder->wait_on_lock = NULL;
-		return; // mlfqs면 도네이트 안하고 바로 리턴해야함
-	}
-
-	if (lock->holder) {
-		cur->wait_on_lock = lock;
-		list_insert_ordered(&lock->holder->donation_list, &cur->donation_elem,cmp_priority_by_donation_elem,NULL);
-		// 그러면, list 내에서 next,prev 설정을 자동적으로 해주겠구나.
-		donate();
-	}
-
-	sema_down (&lock->semaphore);
-	cur->wait_on_lock = NULL;     // sema down이 끝나면, 현재 cur는 작업을 끝낸 것 이므로 기다리는 것이 없음.
-	lock->holder = cur;
+#ifdef LOCKSTAT
+	uint64_t start = lockstat_now ();
+	bool waited = sema_wait (&lock->semaphore, lock);
+	lock->acquired_at = lockstat_acquired (lock->stat, start, waited,
+			__builtin_return_address (0));
+#else
+	sema_wait (&lock->semaphore, lock);
+#endif
+	thread_current ()->lock_cnt++;
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -227,19 +368,42 @@ lock_acquire (struct lock *lock) {
    interrupt handler. */
 bool
 lock_try_acquire (struct lock *lock) {
-	bool success;
+	struct semaphore *sema = &lock->semaphore;
+	enum intr_level old_level;
+	bool success, contended = false;
 
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	success = sema_try_down (&lock->semaphore);
-	if (success)
+	old_level = intr_disable ();
+	spinlock_acquire (&sema->lock);
+	success = sema->value > 0;
+	if (success) {
+		sema->value--;
 		lock->holder = thread_current ();
+		contended = !plist_empty (&sema->waiters);
+	}
+	spinlock_release (&sema->lock);
+	if (contended && !thread_mlfqs) {
+		spinlock_acquire (&donation_lock);
+		lock_take_locked (lock);
+		spinlock_release (&donation_lock);
+	}
+	intr_set_level (old_level);
+
+	if (success) {
+		thread_current ()->lock_cnt++;
+#ifdef LOCKSTAT
+		lock->acquired_at = lockstat_acquired (lock->stat, 0, false, NULL);
+#endif
+	}
 	return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
-   This is lock_release function.
+   This is lock_release function.  We give up whatever priority
+   LOCK's waiters gave us.  If there are none, only LOCK's
+   semaphore's spinlock is taken.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
@@ -249,26 +413,47 @@ lock_release (struct lock *lock) {
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
-	struct list_elem *e;
     struct thread *cur = thread_current ();
+	enum intr_level old_level;
 
+#ifdef LOCKSTAT
+	lockstat_released (lock->stat, lock->acquired_at);
+#endif
   	if (thread_mlfqs) {
+		cur->lock_cnt--;
 		lock->holder = NULL;
     	sema_up (&lock->semaphore);
     	return;
   	}
 
-	/* donation 리스트를 순회하며 */
-    for (e = list_begin (&cur->donation_list); e != list_end (&cur->donation_list); e = list_next (e)){
-		struct thread *t = list_entry (e, struct thread, donation_elem);
-		/* 인자로 받은 lock을 원해서 donate를 한 경우라면 */
-		if (t->wait_on_lock == lock)
-			list_remove (&t->donation_elem);
-    }
-	update_donation();
+	old_level = intr_disable ();
+	spinlock_acquire (&lock->semaphore.lock);
+	/* Only a waiter files LOCK, and waiters stay until we wake
+	   them, so FILED is stable here if there are none. */
+	if (!lock->filed && plist_empty (&lock->semaphore.waiters)) {
+		lock->holder = NULL;
+		lock->semaphore.value++;
+		spinlock_release (&lock->semaphore.lock);
+		cur->lock_cnt--;
+		intr_set_level (old_level);
+		return;
+	}
+	spinlock_release (&lock->semaphore.lock);
 
+	spinlock_acquire (&donation_lock);
+	if (lock->filed) {
+		plist_remove (&cur->held_locks, &lock->elem);
+		lock->filed = false;
+	}
 	lock->holder = NULL;
-	sema_up (&lock->semaphore);
+	cur->lock_cnt--;
+	update_donation_locked ();
+	/* The waiter we wake takes over LOCK's other waiters when it
+	   gets LOCK, in lock_take_locked(). */
+	sema_post (&lock->semaphore);
+	spinlock_release (&donation_lock);
+	preempt ();
+	intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -281,10 +466,526 @@ lock_held_by_current_thread (const struct lock *lock) {
 	return lock->holder == thread_current ();
 }
 
+/* Initializes mutex M as unheld. */
+void
+mutex_init (struct mutex *m) {
+	ASSERT (m != NULL);
+
+	m->holder = NULL;
+	m->waiter_cnt = 0;
+	plist_init (&m->waiters);
+	spinlock_init (&m->lock);
+#ifdef LOCKSTAT
+	m->stat = lockstat_register (NULL, __builtin_return_address (0));
+#endif
+}
+
+/* Initializes M like mutex_init().  With LOCKSTAT, its statistics
+   are kept under NAME, together with those of all other locks and
+   mutexes of that name. */
+void
+mutex_init_named (struct mutex *m, const char *name UNUSED) {
+	ASSERT (m != NULL);
+
+	m->holder = NULL;
+	m->waiter_cnt = 0;
+	plist_init (&m->waiters);
+	spinlock_init (&m->lock);
+#ifdef LOCKSTAT
+	m->stat = lockstat_register (name, NULL);
+#endif
+}
+
+/* Acquires M.  As long as M's holder is running on another CPU we
+   spin, retrying; if it is not, we sleep until mutex_unlock()
+   wakes us and then try again.  M must not already be held by the
+   current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+mutex_lock (struct mutex *m) {
+	struct thread *cur = thread_current ();
+#ifdef LOCKSTAT
+	uint64_t start = lockstat_now ();
+	bool waited = false;
+#endif
+
+	ASSERT (m != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!mutex_held_by_current_thread (m));
+
+	while (!mutex_take (m)) {
+		struct thread *holder = __atomic_load_n (&m->holder, __ATOMIC_RELAXED);
+		enum intr_level old_level;
+
+#ifdef LOCKSTAT
+		waited = true;
+#endif
+
+		/* The holder may exit once it has let go of M, but its
+		   page stays mapped, so the worst a stale look at its
+		   status can do is make us spin once more. */
+		if (holder != NULL
+				&& __atomic_load_n (&holder->status, __ATOMIC_RELAXED)
+					== THREAD_RUNNING) {
+			asm volatile ("pause");
+			continue;
+		}
+
+		old_level = intr_disable ();
+		spinlock_acquire (&m->lock);
+		plist_insert (&m->waiters, &cur->wait_elem, cur->priority);
+		__atomic_add_fetch (&m->waiter_cnt, 1, __ATOMIC_SEQ_CST);
+		/* Either mutex_unlock() sees us counted in waiter_cnt, or
+		   we see that it has let go of M. */
+		if (mutex_take (m)) {
+			plist_remove (&m->waiters, &cur->wait_elem);
+			m->waiter_cnt--;
+			spinlock_release (&m->lock);
+			intr_set_level (old_level);
+			break;
+		}
+		spinlock_release (&m->lock);
+		thread_block ();
+		intr_set_level (old_level);
+	}
+#ifdef LOCKSTAT
+	m->acquired_at = lockstat_acquired (m->stat, start, waited,
+			__builtin_return_address (0));
+#endif
+}
+
+/* Tries to acquire M without spinning or sleeping.  Returns true
+   if successful, false if M is held. */
+bool
+mutex_trylock (struct mutex *m) {
+	ASSERT (m != NULL);
+
+	if (!mutex_take (m))
+		return false;
+#ifdef LOCKSTAT
+	m->acquired_at = lockstat_acquired (m->stat, 0, false, NULL);
+#endif
+	return true;
+}
+
+/* Makes the current thread M's holder if M is free.  Returns true
+   if successful, false if M is held. */
+static bool
+mutex_take (struct mutex *m) {
+	struct thread *unheld = NULL;
+
+	return __atomic_compare_exchange_n (&m->holder, &unheld, thread_current (),
+			false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+/* Releases M, which must be held by the current thread, and wakes
+   up its highest-priority sleeper, if any. */
+void
+mutex_unlock (struct mutex *m) {
+	enum intr_level old_level;
+	struct plist_elem *e;
+
+	ASSERT (m != NULL);
+	ASSERT (mutex_held_by_current_thread (m));
+
+#ifdef LOCKSTAT
+	lockstat_released (m->stat, m->acquired_at);
+#endif
+	__atomic_store_n (&m->holder, NULL, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n (&m->waiter_cnt, __ATOMIC_SEQ_CST) == 0)
+		return;
+
+	old_level = intr_disable ();
+	spinlock_acquire (&m->lock);
+	e = plist_pop_front (&m->waiters);
+	if (e != NULL) {
+		m->waiter_cnt--;
+		thread_unblock (plist_entry (e, struct thread, wait_elem));
+	}
+	spinlock_release (&m->lock);
+	preempt ();
+	intr_set_level (old_level);
+}
+
+/* Returns true if the current thread holds M, false otherwise. */
+bool
+mutex_held_by_current_thread (const struct mutex *m) {
+	ASSERT (m != NULL);
+
+	return m->holder == thread_current ();
+}
+
+/* Initializes RW as held by nobody. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	rw->writer = NULL;
+	rw->filed = false;
+	list_init (&rw->readers);
+	plist_init (&rw->read_waiters);
+	plist_init (&rw->write_waiters);
+	spinlock_init (&rw->lock);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it.  The current thread must not already hold RW, and
+   may read at most RWLOCK_HOLD_MAX rwlocks at once.  Unless we
+   must wait, only RW's spinlock is taken.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_held_for_write (rw));
+
+	old_level = intr_disable ();
+	spinlock_acquire (&rw->lock);
+	if (rw->writer == NULL && plist_empty (&rw->write_waiters)) {
+		rw_add_reader (rw, thread_current ());
+		spinlock_release (&rw->lock);
+		intr_set_level (old_level);
+		return;
+	}
+	spinlock_release (&rw->lock);
+
+	spinlock_acquire (&donation_lock);
+	spinlock_acquire (&rw->lock);
+	if (rw->writer != NULL || !plist_empty (&rw->write_waiters))
+		rw_wait (rw, false);
+	else
+		rw_add_reader (rw, thread_current ());
+	spinlock_release (&rw->lock);
+	spinlock_release (&donation_lock);
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for reading.
+   The last reader out hands RW to the waiters. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	struct thread *cur = thread_current ();
+	struct rwlock_hold *h = NULL;
+	enum intr_level old_level;
+	int i;
+
+	ASSERT (rw != NULL);
+
+	for (i = 0; i < RWLOCK_HOLD_MAX; i++)
+		if (cur->rw_holds[i].rwlock == rw)
+			h = &cur->rw_holds[i];
+	ASSERT (h != NULL);
+
+	old_level = intr_disable ();
+	spinlock_acquire (&rw->lock);
+	if (!h->filed && plist_empty (&rw->read_waiters)
+			&& plist_empty (&rw->write_waiters)) {
+		list_remove (&h->elem);
+		h->rwlock = NULL;
+		cur->lock_cnt--;
+		spinlock_release (&rw->lock);
+		intr_set_level (old_level);
+		return;
+	}
+	spinlock_release (&rw->lock);
+
+	spinlock_acquire (&donation_lock);
+	spinlock_acquire (&rw->lock);
+	list_remove (&h->elem);
+	h->rwlock = NULL;
+	cur->lock_cnt--;
+	if (h->filed) {
+		plist_remove (&cur->held_locks, &h->held_elem);
+		h->filed = false;
+		update_donation_locked ();
+	}
+	if (list_empty (&rw->readers))
+		rw_wake (rw);
+	spinlock_release (&rw->lock);
+	spinlock_release (&donation_lock);
+	preempt ();
+	intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  The current thread must not already hold RW.  Unless we
+   must wait, only RW's spinlock is taken.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (!rwlock_held_for_write (rw));
+
+	old_level = intr_disable ();
+	spinlock_acquire (&rw->lock);
+	if (rw->writer == NULL && list_empty (&rw->readers)
+			&& plist_empty (&rw->write_waiters)) {
+		rw_set_writer (rw, thread_current ());
+		spinlock_release (&rw->lock);
+		intr_set_level (old_level);
+		return;
+	}
+	spinlock_release (&rw->lock);
+
+	spinlock_acquire (&donation_lock);
+	spinlock_acquire (&rw->lock);
+	if (rw->writer != NULL || !list_empty (&rw->readers))
+		rw_wait (rw, true);
+	else
+		rw_set_writer (rw, thread_current ());
+	spinlock_release (&rw->lock);
+	spinlock_release (&donation_lock);
+	intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for writing,
+   and hands it to the waiters. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (rwlock_held_for_write (rw));
+
+	old_level = intr_disable ();
+	spinlock_acquire (&rw->lock);
+	if (!rw->filed && plist_empty (&rw->read_waiters)
+			&& plist_empty (&rw->write_waiters)) {
+		rw->writer = NULL;
+		cur->lock_cnt--;
+		spinlock_release (&rw->lock);
+		intr_set_level (old_level);
+		return;
+	}
+	spinlock_release (&rw->lock);
+
+	spinlock_acquire (&donation_lock);
+	spinlock_acquire (&rw->lock);
+	rw->writer = NULL;
+	cur->lock_cnt--;
+	if (rw->filed) {
+		plist_remove (&cur->held_locks, &rw->elem);
+		rw->filed = false;
+		update_donation_locked ();
+	}
+	rw_wake (rw);
+	spinlock_release (&rw->lock);
+	spinlock_release (&donation_lock);
+	preempt ();
+	intr_set_level (old_level);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rwlock_held_for_write (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return rw->writer == thread_current ();
+}
+
+/* Queues the current thread on RW for reading or, if WRITE, for
+   writing, and sleeps until rw_wake() has made it a holder.
+   donation_lock and RW's lock must be held. */
+static void
+rw_wait (struct rwlock *rw, bool write) {
+	struct thread *cur = thread_current ();
+
+	plist_insert (write ? &rw->write_waiters : &rw->read_waiters,
+			&cur->wait_elem, cur->priority);
+	cur->wait_on_rwlock = rw;
+	cur->wait_rw_write = write;
+	rw_pi_update (rw);
+	spinlock_release (&rw->lock);
+	spinlock_release (&donation_lock);
+	thread_block ();
+	spinlock_acquire (&donation_lock);
+	spinlock_acquire (&rw->lock);
+	ASSERT (cur->wait_on_rwlock == NULL);
+}
+
+/* RW has just become free.  Hands it to its top waiting writer
+   or, if there is none, to all of its waiting readers.
+   donation_lock and RW's lock must be held. */
+static void
+rw_wake (struct rwlock *rw) {
+	struct thread *t;
+
+	if (!plist_empty (&rw->write_waiters)) {
+		t = plist_entry (plist_pop_front (&rw->write_waiters),
+				struct thread, wait_elem);
+		t->wait_on_rwlock = NULL;
+		rw_set_writer (rw, t);
+		thread_unblock (t);
+	} else {
+		while (!plist_empty (&rw->read_waiters)) {
+			t = plist_entry (plist_pop_front (&rw->read_waiters),
+					struct thread, wait_elem);
+			t->wait_on_rwlock = NULL;
+			rw_add_reader (rw, t);
+			thread_unblock (t);
+		}
+	}
+	/* The new holders inherit from the waiters left. */
+	rw_pi_update (rw);
+}
+
+/* Makes T, which is either running or was just dequeued from RW,
+   a reader of RW.  RW's lock must be held.  The new hold is not
+   filed; rw_pi_update() files it if RW has waiters. */
+static void
+rw_add_reader (struct rwlock *rw, struct thread *t) {
+	struct rwlock_hold *h = NULL;
+	int i;
+
+	for (i = 0; i < RWLOCK_HOLD_MAX && h == NULL; i++)
+		if (t->rw_holds[i].rwlock == NULL)
+			h = &t->rw_holds[i];
+	ASSERT (h != NULL);
+
+	h->rwlock = rw;
+	h->thread = t;
+	h->filed = false;
+	list_push_back (&rw->readers, &h->elem);
+	t->lock_cnt++;
+}
+
+/* Makes T, which is either running or was just dequeued from RW,
+   RW's writer.  RW's lock must be held.  As with readers, RW is
+   filed only if it has waiters. */
+static void
+rw_set_writer (struct rwlock *rw, struct thread *t) {
+	rw->writer = t;
+	rw->filed = false;
+	t->lock_cnt++;
+}
+
+/* Returns the priority of RW's top waiter, reader or writer, or
+   PRI_MIN - 1 if there is none.  RW's lock must be held. */
+static int
+rw_max_priority (struct rwlock *rw) {
+	struct plist_elem *r = plist_front (&rw->read_waiters);
+	struct plist_elem *w = plist_front (&rw->write_waiters);
+	int priority = PRI_MIN - 1;
+
+	if (r != NULL && r->priority > priority)
+		priority = r->priority;
+	if (w != NULL && w->priority > priority)
+		priority = w->priority;
+	return priority;
+}
+
+/* Like pi_update(), but for RW, which passes its waiters'
+   priority on to its writer or to every one of its readers.
+   donation_lock and RW's lock must be held. */
+static void
+rw_pi_update (struct rwlock *rw) {
+	int priority = rw_max_priority (rw);
+	struct list_elem *e;
+
+	if (thread_mlfqs)
+		return;
+	if (rw->writer != NULL) {
+		held_file (rw->writer, &rw->elem, &rw->filed, priority);
+		pi_refresh (rw->writer);
+	}
+	for (e = list_begin (&rw->readers); e != list_end (&rw->readers);
+			e = list_next (e)) {
+		struct rwlock_hold *h = list_entry (e, struct rwlock_hold, elem);
+
+		held_file (h->thread, &h->held_elem, &h->filed, priority);
+		pi_refresh (h->thread);
+	}
+}
+
+/* Initializes SL. */
+void
+seqlock_init (struct seqlock *sl) {
+	ASSERT (sl != NULL);
+
+	sl->seq = 0;
+	spinlock_init (&sl->lock);
+}
+
+/* Starts a read of the data SL protects and returns the sequence
+   number to pass to seqlock_read_retry() afterward.  Waits for a
+   write in progress on another CPU to finish. */
+unsigned
+seqlock_read_begin (const struct seqlock *sl) {
+	unsigned seq;
+
+	while ((seq = __atomic_load_n (&sl->seq, __ATOMIC_ACQUIRE)) & 1)
+		asm volatile ("pause");
+	return seq;
+}
+
+/* Returns true if a write to the data SL protects may have
+   overlapped the read that seqlock_read_begin() returned SEQ for,
+   in which case the read must be done over. */
+bool
+seqlock_read_retry (const struct seqlock *sl, unsigned seq) {
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+	return __atomic_load_n (&sl->seq, __ATOMIC_RELAXED) != seq;
+}
+
+/* Starts a write to the data SL protects.  Interrupts must be
+   off. */
+void
+seqlock_write_begin (struct seqlock *sl) {
+	spinlock_acquire (&sl->lock);
+	__atomic_store_n (&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+/* Ends a write to the data SL protects. */
+void
+seqlock_write_end (struct seqlock *sl) {
+	__atomic_store_n (&sl->seq, sl->seq + 1, __ATOMIC_RELEASE);
+	spinlock_release (&sl->lock);
+}
+
+/* Lets the running thread, which has just become LOCK's holder,
+   inherit the priority of LOCK's remaining waiters.  donation_lock
+   must be held. */
+static void
+lock_take_locked (struct lock *lock) {
+	held_file (thread_current (), &lock->elem, &lock->filed,
+			lock_max_priority (lock));
+	update_donation_locked ();
+}
+
+/* Files E, T's hold on a lock or rwlock whose top waiter has
+   PRIORITY, on T's held_locks, or re-keys it there if *FILED says
+   it is filed already.  A hold with no waiters is left unfiled.
+   donation_lock must be held. */
+static void
+held_file (struct thread *t, struct plist_elem *e, bool *filed,
+		int priority) {
+	if (*filed)
+		plist_requeue (&t->held_locks, e, priority);
+	else if (priority >= PRI_MIN) {
+		plist_insert (&t->held_locks, e, priority);
+		*filed = true;
+	}
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem {
-	struct list_elem elem;              /* List element. */
+	struct plist_elem elem;             /* List element. */
 	struct semaphore semaphore;         /* This semaphore. */
+	struct thread *thread;              /* Thread waiting on it. */
 };
 
 /* Initializes condition variable COND.  A condition variable
@@ -294,7 +995,8 @@ void
 cond_init (struct condition *cond) {
 	ASSERT (cond != NULL);
 
-	list_init (&cond->waiters);
+	plist_init (&cond->waiters);
+	spinlock_init (&cond->lock);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -316,10 +1018,16 @@ cond_init (struct condition *cond) {
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
-   we need to sleep. */
+   we need to sleep.
+
+   Waiters are signaled in order of priority, including priority
+   they inherit while they wait. */
 void
 cond_wait (struct condition *cond, struct lock *lock) {
+	struct thread *cur = thread_current ();
 	struct semaphore_elem waiter;
+	enum intr_level old_level;
+	bool donee;
 
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
@@ -327,10 +1035,33 @@ cond_wait (struct condition *cond, struct lock *lock) {
 	ASSERT (lock_held_by_current_thread (lock));
 
 	sema_init (&waiter.semaphore, 0);
-//	list_insert_ordered(&cond->waiters, &waiter.elem, cmp_priority_by_sema , NULL); 교수님 틀림.
-	list_push_back(&cond->waiters, &waiter.elem); // 그냥 넣어줘도 됨.
+	waiter.thread = cur;
+
+	/* As in sema_wait(), pi_update() must find us either queued
+	   under our current priority or not queued. */
+	old_level = intr_disable ();
+	if (!thread_mlfqs)
+		spinlock_acquire (&donation_lock);
+	spinlock_acquire (&cond->lock);
+	plist_insert (&cond->waiters, &waiter.elem, cur->priority);
+	cur->wait_cond = cond;
+	cur->wait_cond_elem = &waiter.elem;
+	spinlock_release (&cond->lock);
+	if (!thread_mlfqs)
+		spinlock_release (&donation_lock);
+	intr_set_level (old_level);
+
 	lock_release (lock);			// 소유권을 놔줌 == 락 릴리즈.
+	donee = !thread_mlfqs && cur->lock_cnt > 0;
 	sema_down (&waiter.semaphore);
+	if (donee) {
+		/* set_priority_locked() may still be looking at COND,
+		   which our caller may free once we return. */
+		old_level = intr_disable ();
+		spinlock_acquire (&donation_lock);
+		spinlock_release (&donation_lock);
+		intr_set_level (old_level);
+	}
 	lock_acquire (lock); // 다시 취득해야함.
 }
 
@@ -343,15 +1074,26 @@ cond_wait (struct condition *cond, struct lock *lock) {
    interrupt handler. */
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) {
+	struct semaphore_elem *waiter = NULL;
+	enum intr_level old_level;
+	struct plist_elem *e;
+
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if (!list_empty (&cond->waiters)) {
-		list_sort(&cond->waiters,cmp_priority_by_sema,NULL); // pop 할때 정렬이 안되어 있을 수 있나?
-		sema_up(&list_entry (list_pop_front (&cond->waiters), struct semaphore_elem, elem)->semaphore);
+	old_level = intr_disable ();
+	spinlock_acquire (&cond->lock);
+	e = plist_pop_front (&cond->waiters);
+	if (e != NULL) {
+		waiter = plist_entry (e, struct semaphore_elem, elem);
+		waiter->thread->wait_cond = NULL;
 	}
+	spinlock_release (&cond->lock);
+	intr_set_level (old_level);
+	if (waiter != NULL)
+		sema_up (&waiter->semaphore);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -365,67 +1107,137 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	ASSERT (cond != NULL);
 	ASSERT (lock != NULL);
 
-	while (!list_empty (&cond->waiters))
+	while (!plist_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
 
-bool
-cmp_priority_by_donation_elem(const struct list_elem *a_, const struct list_elem *b_,
-            void *aux UNUSED)
-{
-    const struct thread *a = list_entry(a_, struct thread, donation_elem);
-    const struct thread *b = list_entry(b_, struct thread, donation_elem);
+/* Returns the priority of LOCK's top waiter, or PRI_MIN - 1 if
+   there is none.  donation_lock must be held. */
+static int
+lock_max_priority (struct lock *lock) {
+	struct plist_elem *top = plist_front (&lock->semaphore.waiters);
 
-    return a->priority > b->priority;
+	return top != NULL ? top->priority : PRI_MIN - 1;
 }
 
-bool
-cmp_priority_by_sema( const struct list_elem *list_elem_a, const struct list_elem *list_elem_b,
-            void *aux UNUSED)
-{
-	// *waiter -> semaphore -> list -> front ==>>>> thread??
-	struct semaphore_elem *sema_a = list_entry(list_elem_a, struct semaphore_elem, elem);
-	struct semaphore_elem *sema_b = list_entry(list_elem_b, struct semaphore_elem, elem);
+/* Returns the priority T should have: its own, or that of the top
+   waiter of a lock it holds, whichever is higher.  donation_lock
+   must be held. */
+static int
+inherited_priority (struct thread *t) {
+	struct plist_elem *top = plist_front (&t->held_locks);
 
-	struct list *waiters_a = &(sema_a->semaphore.waiters);
-	struct list *waiters_b = &(sema_b->semaphore.waiters);
+	if (top != NULL && top->priority > t->original_priority)
+		return top->priority;
+	return t->original_priority;
+}
 
-	struct thread *a = list_entry(list_begin(waiters_a),struct thread, elem);
-	struct thread *b = list_entry(list_begin(waiters_b),struct thread, elem);
+/* LOCK's waiters, or the priority of one of them, have changed.
+   Brings the priorities along the chain of holders starting at
+   LOCK's up to date; see the comment at the top of this file.
+   donation_lock must be held. */
+static void
+pi_update (struct lock *lock) {
+	struct thread *holder = lock->holder;
+
+	/* Between a release and the next holder taking over,
+	   lock_take_locked() will pick up the waiters. */
+	if (holder == NULL)
+		return;
+	held_file (holder, &lock->elem, &lock->filed, lock_max_priority (lock));
+	pi_refresh (holder);
+}
+
+/* Something T holds has been re-keyed.  Recomputes T's priority
+   and, if it changed, passes the change on to whatever T waits
+   for.  Chains of locks are followed in a loop; only a rwlock,
+   which may have many holders, recurses.  donation_lock must be
+   held. */
+static void
+pi_refresh (struct thread *t) {
+	for (;;) {
+		int priority = inherited_priority (t);
+		struct thread *holder;
+		struct rwlock *rw;
+		struct lock *lock;
+
+		if (priority == t->priority)
+			return;
+		set_priority_locked (t, priority);
 
-	return a->priority > b->priority;
+		rw = t->wait_on_rwlock;
+		if (rw != NULL) {
+			spinlock_acquire (&rw->lock);
+			rw_pi_update (rw);
+			spinlock_release (&rw->lock);
+			return;
+		}
+		lock = t->wait_on_lock;
+		holder = lock != NULL ? lock->holder : NULL;
+		if (holder == NULL)
+			return;
+		held_file (holder, &lock->elem, &lock->filed,
+				lock_max_priority (lock));
+		t = holder;
+	}
 }
 
-void
-donate(void) {
-	struct thread *cur = thread_current();
-	for (int i=0; i<8; i++) {
-		if (cur->wait_on_lock == NULL) return;
-		if (cur->priority > cur->wait_on_lock->holder->priority) {
-			cur->wait_on_lock->holder->priority = cur->priority; // priority 변경
-			cur = cur->wait_on_lock->holder; // cur = next(cur); 와 비슷한 느낌.
-		}else {
+/* Sets T's priority to PRIORITY.  If T is queued on a semaphore,
+   moves it to its new place in the queue.  donation_lock must be
+   held, which keeps that semaphore valid; see sema_wait().  If T
+   is queued on a rwlock instead, the same goes for that, and if T
+   is waiting on a condition variable, for the condition's queue
+   too; see cond_wait(). */
+static void
+set_priority_locked (struct thread *t, int priority) {
+	struct semaphore *sema = t->wait_sema;
+	struct rwlock *rw = t->wait_on_rwlock;
+	struct condition *cond = t->wait_cond;
+
+	if (rw != NULL) {
+		spinlock_acquire (&rw->lock);
+		plist_requeue (t->wait_rw_write
+				? &rw->write_waiters : &rw->read_waiters,
+				&t->wait_elem, priority);
+		spinlock_release (&rw->lock);
+		t->priority = priority;
+		return;
+	}
+	if (cond != NULL) {
+		spinlock_acquire (&cond->lock);
+		if (t->wait_cond == cond)
+			plist_requeue (&cond->waiters, t->wait_cond_elem, priority);
+		spinlock_release (&cond->lock);
+	}
+	if (sema != NULL) {
+		spinlock_acquire (&sema->lock);
+		if (t->wait_sema == sema) {
+			plist_requeue (&sema->waiters, &t->wait_elem, priority);
+			t->priority = priority;
+			spinlock_release (&sema->lock);
 			return;
 		}
+		spinlock_release (&sema->lock);
 	}
+	thread_change_priority (t, priority);
 }
 
+/* Recomputes the running thread's priority from its base
+   priority and the waiters for the locks it holds. */
 void 
 update_donation() {
+	enum intr_level old_level = intr_disable ();
+
+	spinlock_acquire (&donation_lock);
+	update_donation_locked ();
+	spinlock_release (&donation_lock);
+	intr_set_level (old_level);
+}
+
+/* update_donation() with donation_lock held. */
+static void
+update_donation_locked (void) {
 	struct thread *cur = thread_current();
-	struct list_elem *e;
 
-	int max_priority = 0;
-	cur->priority = cur->original_priority;
-	
-	if (!list_empty(&cur->donation_list)) {
-		list_sort(&cur->donation_list, cmp_priority_by_donation_elem, 0);
-		e = list_front(&cur->donation_list);
-		struct thread *max = list_entry(e, struct thread, donation_elem);
-		max_priority = max->priority;
-	}
-	// list가 비어있는 경우를 생각해서, 미리 cur->priority = cur->original_priority 를 수행해놔야함.
-	if (max_priority > cur->priority) {
-		cur->priority = max_priority;
-	}
+	cur->priority = inherited_priority (cur);
 }
\ No newline at end of file
@@ -3,7 +3,15 @@ threads_SRC += threads/thread.c		# Thread management core.
 threads_SRC += threads/interrupt.c	# Interrupt core.
 threads_SRC += threads/intr-stubs.S	# Interrupt stubs.
 threads_SRC += threads/synch.c		# Synchronization.
+threads_SRC += threads/lockstat.c	# Lock contention statistics.
 threads_SRC += threads/palloc.c		# Page allocator.
 threads_SRC += threads/malloc.c		# Subpage allocator.
+threads_SRC += threads/slab.c		# Object caches.
+threads_SRC += threads/vmalloc.c	# Virtually contiguous allocations.
 threads_SRC += threads/start.S		# Startup code.
+threads_SRC += threads/spinlock.c	# Spin locks.
+threads_SRC += threads/cpu.c		# Per-CPU state and SMP startup.
+threads_SRC += threads/lapic.c		# Local APIC.
+threads_SRC += threads/ioapic.c		# I/O APIC.
+threads_SRC += threads/ap-start.S	# Application processor startup.
 threads_SRC += threads/mmu.c		    # Memory management unit related things.
@@ -1,16 +1,20 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <limits.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/fixed_point.h";
+#include "devices/timer.h"
 
 #include "intrinsic.h"
 #ifdef USERPROG
@@ -26,37 +30,70 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-static struct list sleep_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  Each CPU has its own
+   run queue and only ever runs threads from it.  There is one
+   FIFO list per priority level; bit P of `mask' is set iff
+   queues[P] is non-empty, so the highest ready priority is found
+   with a single bit scan instead of walking a sorted list.
+
+   A run queue's lock also covers the `status' of the threads
+   filed on it, and of the thread running on its CPU.  The
+   scheduler takes it in do_schedule() and it stays held across
+   the switch; whichever thread runs next releases it, in
+   schedule() or, for a new thread, in kernel_thread().
+
+   A thread may sit on the run queue of a CPU its affinity mask
+   does not allow, after thread_set_affinity() or a wake-up.  Such
+   a thread is "misplaced": its CPU skips over it and the load
+   balancer moves it elsewhere first. */
+#if PRI_MAX >= 64
+#error mask requires PRI_MAX < 64
+#endif
+struct runqueue {
+	struct spinlock lock;
+	struct list queues[PRI_MAX + 1];
+	uint64_t mask;
+	size_t cnt;                 /* # of threads in queues. */
+	size_t misplaced;           /* # of those not allowed on this CPU. */
+};
+static struct runqueue runqueues[CPU_MAX];
+
+/* Sleeping threads, keyed on the tick they should wake up at.
+   A pairing heap gives O(1) insertion and an exact earliest
+   deadline, and lets a sleep be cancelled without a search. */
+static struct heap sleep_heap;
+static struct spinlock sleep_lock;
 static struct list all_list;
+static struct spinlock all_lock;
 
-/* Global ticks that can wake up the sleeping threads */
+/* Earliest wake-up tick in sleep_heap, or INT64_MAX if nobody is
+   sleeping.  The timer interrupt compares against this alone. */
 static int64_t global_ticks;
 
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
 /* Lock used by allocate_tid(). */
-static struct lock tid_lock;
-
-/* Thread destruction requests */
-static struct list destruction_req;
+static struct mutex tid_lock;
 
-/* load_avg */
+/* load_avg, written by the timer interrupt and read from any
+   CPU through load_avg_seq. */
 static int load_avg;
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
+static struct seqlock load_avg_seq = SEQLOCK_INITIALIZER;
+
+/* MLFQS epochs: one per second of uptime.  decay_hist[E %
+   DECAY_HIST] holds the recent_cpu decay factor for epoch E. */
+#define DECAY_HIST 256
+static unsigned mlfqs_epoch;
+static int decay_hist[DECAY_HIST];
+/* Statistics and the time slice are kept per CPU, in struct
+   cpu. */
 
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+#define BALANCE_INTERVAL 4      /* # of timer ticks between balancing runs
+                                   on a busy CPU; idle CPUs run every tick. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
@@ -66,11 +103,25 @@ bool thread_mlfqs;
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
-static struct thread *next_thread_to_run (void);
+static void idle_loop (void) NO_RETURN;
+static struct thread *next_thread_to_run (struct runqueue *, struct cpu *);
 static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule (void);
+static void schedule_tail (void);
 static tid_t allocate_tid (void);
+static int select_cpu (unsigned affinity);
+static size_t cpu_load (int cpu);
+static void load_balance (struct cpu *);
+static struct thread *steal_thread (struct runqueue *, struct cpu *, bool idle);
+static struct thread *rq_pick (struct runqueue *, int cpu, bool misplaced);
+static struct runqueue *thread_rq_lock (struct thread *);
+static void ready_push (struct runqueue *, struct thread *);
+static void ready_remove (struct runqueue *, struct thread *);
+static int ready_max_priority (const struct runqueue *);
+static void kick_cpu (struct thread *);
+static bool mlfqs_catch_up (struct runqueue *, struct thread *);
+static int mlfqs_priority (const struct thread *);
 bool cmp_thread_priority(const struct list_elem *a_, const struct list_elem *b_,
             void *aux UNUSED);
 void preempt();
@@ -78,6 +129,12 @@ void preempt();
 /* Returns true if T appears to point to a valid thread. */
 #define is_thread(t) ((t) != NULL && (t)->magic == THREAD_MAGIC)
 
+/* Returns true if T is its CPU's idle thread. */
+#define is_idle_thread(t) ((t) == cpus[(t)->cpu].idle_thread)
+
+/* Returns true if T's affinity mask allows it to run on CPU. */
+#define cpu_allowed(t, cpu) (((t)->affinity >> (cpu)) & 1)
+
 /* Returns the running thread.
  * Read the CPU's stack pointer `rsp', and then round that
  * down to the start of a page.  Since `struct thread' is
@@ -118,11 +175,21 @@ thread_init (void) {
 	lgdt (&gdt_ds);
 
 	/* Init the globla thread context */
-	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init (&sleep_list);
-	list_init (&destruction_req);
+	mutex_init_named (&tid_lock, "tid");
+	for (int i = 0; i < CPU_MAX; i++) {
+		struct runqueue *rq = &runqueues[i];
+
+		spinlock_init (&rq->lock);
+		for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+			list_init (&rq->queues[pri]);
+		rq->mask = 0;
+		rq->cnt = 0;
+		rq->misplaced = 0;
+	}
+	heap_init (&sleep_heap, ticks_less, NULL);
+	spinlock_init (&sleep_lock);
 	list_init (&all_list);
+	spinlock_init (&all_lock);
 
 	/* Init global_ticks to track the minimum ticks */
 	global_ticks = INT64_MAX; // global_ticks의 타입은 
@@ -133,6 +200,7 @@ thread_init (void) {
 	list_push_back(&all_list, &(initial_thread->allelem));
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
+	cpus[0].curr = initial_thread;
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -156,21 +224,29 @@ thread_start (void) {
    Thus, this function runs in an external interrupt context. */
 void
 thread_tick (void) {
+	struct cpu *c = cpu_current ();
 	struct thread *t = thread_current ();
 
 	/* Update statistics. */
-	if (t == idle_thread)
-		idle_ticks++;
+	if (t == c->idle_thread)
+		c->idle_ticks++;
 #ifdef USERPROG
 	else if (t->pml4 != NULL)
-		user_ticks++;
+		c->user_ticks++;
 #endif
 	else
-		kernel_ticks++;
+		c->kernel_ticks++;
 
 	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	if (++c->thread_ticks >= TIME_SLICE)
 		intr_yield_on_return ();
+
+	/* Pull work from busier CPUs. */
+	if (cpu_cnt > 1
+			&& (t == c->idle_thread || ++c->balance_ticks >= BALANCE_INTERVAL)) {
+		c->balance_ticks = 0;
+		load_balance (c);
+	}
 }
 
 /*  Threads need to sleep instead of busy wait! 
@@ -195,41 +271,86 @@ thread_sleep(int64_t howLong) {
 	old_level = intr_disable(); 
 
 	curr = thread_current();
-	ASSERT(curr != idle_thread);
+	ASSERT(!is_idle_thread (curr));
 
-	curr->local_ticks = howLong;
-	list_insert_ordered(&sleep_list, &curr->elem, ticks_less ,NULL);
-	set_global_ticks(); 
+	thread_sleep_prepare (howLong);
 	thread_block();
 
 	// 2) intr able 
 	intr_set_level(old_level);
 }
 
+/* Files the running thread on the sleep heap to be woken at tick
+   WAKE_TICK, but does not block it.  The caller must call
+   thread_block() next, with interrupts still off; it may be woken
+   earlier through thread_sleep_cancel().  Lets a thread sleep on
+   some other event and a timeout at once. */
+void
+thread_sleep_prepare (int64_t wake_tick) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	curr->local_ticks = wake_tick;
+	spinlock_acquire (&sleep_lock);
+	heap_insert (&sleep_heap, &curr->sleep_elem);
+	set_global_ticks(); 
+	spinlock_release (&sleep_lock);
+}
+
 void
 thread_wakeup(int64_t ticks) { // OS ticks from timer! 
 
-	struct list_elem *e = list_begin (&sleep_list);
 	struct thread *cur;
-	struct list_elem *next;
 	ASSERT (intr_context ());
 	
+	spinlock_acquire (&sleep_lock);
 	// ticks와 동일한 시간에 깨어나야 하는 쓰레드가 여러개 있을 수 있으니까 반복문으로 체크합니다.
-  	while (!list_empty(&sleep_list)) // incr 'e' inside of the loop by doing e = list_next;
+  	while (!heap_empty (&sleep_heap))
 	{
-        cur = list_entry (e, struct thread, elem); // just get that elem.
+        cur = heap_entry (heap_min (&sleep_heap), struct thread, sleep_elem);
 		
 		// Time to wake up
 		if (cur->local_ticks > ticks) break;
-		e = list_remove(e);
+		heap_pop_min (&sleep_heap);
 		thread_unblock(cur); // 이미 만들어진 함수에서 다 처리
     }
 	set_global_ticks();
+	spinlock_release (&sleep_lock);
+}
+
+/* Cancels T's pending thread_sleep() and makes T ready to run
+   immediately.  Returns true if T was sleeping, false otherwise. */
+bool
+thread_sleep_cancel (struct thread *t) {
+	enum intr_level old_level;
+	bool sleeping;
+
+	ASSERT (is_thread (t));
+
+	old_level = intr_disable ();
+	spinlock_acquire (&sleep_lock);
+	sleeping = heap_contains (&sleep_heap, &t->sleep_elem);
+	if (sleeping) {
+		heap_remove (&sleep_heap, &t->sleep_elem);
+		set_global_ticks ();
+		thread_unblock (t);
+	}
+	spinlock_release (&sleep_lock);
+	intr_set_level (old_level);
+	return sleeping;
 }
 
 /* Prints thread statistics. */
 void
 thread_print_stats (void) {
+	long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+
+	for (int i = 0; i < cpu_cnt; i++) {
+		idle_ticks += cpus[i].idle_ticks;
+		kernel_ticks += cpus[i].kernel_ticks;
+		user_ticks += cpus[i].user_ticks;
+	}
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
 }
@@ -254,6 +375,7 @@ thread_create (const char *name, int priority,
 		thread_func *function, void *aux) {
 	struct thread *t;
 	tid_t tid;
+	enum intr_level old_level;
 
 	ASSERT (function != NULL);
 
@@ -275,9 +397,17 @@ thread_create (const char *name, int priority,
 	t->tf.es = SEL_KDSEG;
 	t->tf.ss = SEL_KDSEG;
 	t->tf.cs = SEL_KCSEG;
-	t->tf.eflags = FLAG_IF;
+	/* kernel_thread() turns interrupts on once it has released the
+	   run queue lock. */
+	t->tf.eflags = 0;
+	t->affinity = thread_current ()->affinity;
+	t->cpu = select_cpu (t->affinity);
 
+	old_level = intr_disable ();
+	spinlock_acquire (&all_lock);
 	list_push_back(&all_list, &t->allelem);
+	spinlock_release (&all_lock);
+	intr_set_level (old_level);
 
 	/* Add to run queue. */
 	thread_unblock (t);
@@ -290,13 +420,19 @@ thread_create (const char *name, int priority,
 
    This function must be called with interrupts turned off.  It
    is usually a better idea to use one of the synchronization
-   primitives in synch.h. */
+   primitives in synch.h.
+
+   With more than one CPU, the thread that is to wake us up may
+   call thread_unblock() on another CPU after we have made
+   ourselves findable (put ourselves on a wait list, say) but
+   before we get here.  The wake-up is then left pending and this
+   function returns at once, so callers must re-check whatever
+   they are waiting for, as sema_down() does. */
 void
 thread_block (void) {
 	ASSERT (!intr_context ());
 	ASSERT (intr_get_level () == INTR_OFF);
-	thread_current ()->status = THREAD_BLOCKED;
-	schedule ();
+	do_schedule (THREAD_BLOCKED);
 }
 
 /* Transitions a blocked thread T to the ready-to-run state.
@@ -310,14 +446,28 @@ thread_block (void) {
 void
 thread_unblock (struct thread *t) {
 	enum intr_level old_level;
+	struct runqueue *rq;
 
 	ASSERT (is_thread (t));
 
 	old_level = intr_disable ();
-	ASSERT (t->status == THREAD_BLOCKED);
-	// list_push_back (&ready_list, &t->elem);
-	list_insert_ordered(&ready_list, &t->elem, cmp_thread_priority,NULL);
-	t->status = THREAD_READY;
+	rq = thread_rq_lock (t);
+	if (t->status == THREAD_RUNNING) {
+		/* T is still on its way into thread_block() on another
+		   CPU.  See the comment there. */
+		ASSERT (t->cpu != cpu_current ()->id);
+		t->wake_pending = true;
+	} else {
+		ASSERT (t->status == THREAD_BLOCKED);
+		if (thread_mlfqs && !is_idle_thread (t)) {
+			calc_recent_cpu (t);
+			t->priority = mlfqs_priority (t);
+		}
+		ready_push (rq, t);
+		t->status = THREAD_READY;
+		kick_cpu (t);
+	}
+	spinlock_release (&rq->lock);
 	intr_set_level (old_level);
 }
 
@@ -363,8 +513,10 @@ thread_exit (void) {
 
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
-	list_remove(&thread_current()->allelem);
 	intr_disable ();
+	spinlock_acquire (&all_lock);
+	list_remove(&thread_current()->allelem);
+	spinlock_release (&all_lock);
 	do_schedule (THREAD_DYING);
 	NOT_REACHED ();
 }
@@ -373,14 +525,9 @@ thread_exit (void) {
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void) {
-	struct thread *curr = thread_current ();
 	enum intr_level old_level;
 	old_level = intr_disable ();
 	ASSERT (!intr_context ());
-	if (curr != idle_thread) {
-		// list_push_back (&ready_list, &curr->elem);
-		list_insert_ordered(&ready_list, &curr->elem, cmp_thread_priority,NULL);
-	}
 	do_schedule (THREAD_READY);
 	intr_set_level (old_level);
 }
@@ -396,6 +543,27 @@ thread_set_priority (int new_priority) {
 	preempt();
 }
 
+/* Restricts the running thread to the CPUs in MASK, bit N
+   standing for CPU N.  Returns false, changing nothing, if MASK
+   names no CPU that is online.  If the thread may no longer run
+   where it is, it yields and another CPU's load balancer picks it
+   up. */
+bool
+thread_set_affinity (unsigned mask) {
+	struct thread *cur = thread_current ();
+	enum intr_level old_level;
+
+	if ((mask & ((1u << cpu_cnt) - 1)) == 0)
+		return false;
+
+	old_level = intr_disable ();
+	cur->affinity = mask;
+	if (!cpu_allowed (cur, cur->cpu))
+		thread_yield ();
+	intr_set_level (old_level);
+	return true;
+}
+
 /* Returns the current thread's priority. */
 int
 thread_get_priority (void) {
@@ -426,11 +594,14 @@ thread_get_nice (void) {
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	enum intr_level old_level;
-	old_level = intr_disable();
-	int ret = fixed_to_int_round (fixed_mul_int (load_avg, 100)); 
-	intr_set_level(old_level);
-  	return ret;
+	unsigned seq;
+	int avg;
+
+	do {
+		seq = seqlock_read_begin (&load_avg_seq);
+		avg = load_avg;
+	} while (seqlock_read_retry (&load_avg_seq, seq));
+	return fixed_to_int_round (fixed_mul_int (avg, 100));
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
@@ -455,15 +626,77 @@ thread_get_recent_cpu (void) {
 static void
 idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
+	enum intr_level old_level;
 
-	idle_thread = thread_current ();
+	old_level = intr_disable ();
+	cpu_current ()->idle_thread = thread_current ();
+	intr_set_level (old_level);
 	sema_up (idle_started);
 
+	idle_loop ();
+}
+
+/* Sets up the idle thread for secondary CPU C, which will start
+   out running it, on its stack, when it reaches ap_main().
+   Returns the thread, or a null pointer if memory is short. */
+struct thread *
+thread_prepare_ap (struct cpu *c) {
+	struct thread *t;
+	char name[16];
+
+	t = palloc_get_page (PAL_ZERO);
+	if (t == NULL)
+		return NULL;
+
+	snprintf (name, sizeof name, "idle%d", c->id);
+	init_thread (t, name, PRI_MIN);
+	t->tid = allocate_tid ();
+	t->status = THREAD_RUNNING;
+	t->cpu = c->id;
+	c->idle_thread = c->curr = t;
+	return t;
+}
+
+/* Called by a secondary CPU, with interrupts off, once it is
+   ready to run threads.  Turns the CPU over to the scheduler. */
+void
+thread_start_ap (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spinlock_acquire (&all_lock);
+	list_push_back (&all_list, &thread_current ()->allelem);
+	spinlock_release (&all_lock);
+	idle_loop ();
+}
+
+/* The idle thread's main loop. */
+static void
+idle_loop (void) {
+	struct runqueue *rq;
+
 	for (;;) {
 		/* Let someone else run. */
 		intr_disable ();
 		thread_block ();
 
+		/* Nobody else is runnable: zero free pages for PAL_ZERO
+		   requests ahead of time, one page at a time with
+		   interrupts on.  Wakeups on this CPU do not preempt us, so
+		   check for them after each page, and go back to the
+		   scheduler instead of halting if there were any. */
+		rq = &runqueues[thread_current ()->cpu];
+		intr_enable ();
+		while (rq->cnt == rq->misplaced && palloc_zero_idle ())
+			continue;
+		intr_disable ();
+		if (rq->cnt != rq->misplaced)
+			continue;
+
+		/* With -nohz, stop the periodic tick until the next
+		   sleeper is due.  schedule() restarts it when we are
+		   switched out. */
+		timer_idle_enter ();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -485,6 +718,7 @@ static void
 kernel_thread (thread_func *function, void *aux) {
 	ASSERT (function != NULL);
 
+	schedule_tail ();     /* Finish the switch that got us here. */
 	intr_enable ();       /* The scheduler runs with interrupts off. */
 	function (aux);       /* Execute the thread function. */
 	thread_exit ();       /* If function() returns, kill the thread. */
@@ -510,30 +744,296 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t->magic = THREAD_MAGIC;
 
 	t->wait_on_lock = NULL;
-	list_init(&t->donation_list);
+	plist_init (&t->held_locks);
 	t->original_priority = priority;
 
+	t->affinity = UINT_MAX;
 	t->nice = NICE_DEFAULT;
 	t->recent_cpu = RECENT_CPU_DEFAULT;
+	t->recent_cpu_epoch = mlfqs_epoch;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Chooses and returns the next thread for CPU C to run, from
+   its run queue RQ, whose lock must be held.  Should return a
+   thread from the run queue, unless the run queue is empty.  (If
+   the running thread can continue running, then it will be in
+   the run queue.)  If the run queue is empty, return C's idle
+   thread.
+
+   Under MLFQS, ready threads are filed under the priority they had
+   in the epoch they were last brought up to date in.  The thread
+   picked is caught up first; if that moves it to another level,
+   the pick is made again. */
 static struct thread *
-next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+next_thread_to_run (struct runqueue *rq, struct cpu *c) {
+	struct thread *t;
+
+	do {
+		if (rq->misplaced == 0 && rq->mask != 0)
+			t = list_entry (list_front (&rq->queues[ready_max_priority (rq)]),
+					struct thread, elem);
+		else
+			t = rq_pick (rq, c->id, false);
+	} while (t != NULL && mlfqs_catch_up (rq, t));
+
+	/* About to go idle: try to take work from another CPU. */
+	if (t == NULL && cpu_cnt > 1)
+		t = steal_thread (rq, c, true);
+	if (t == NULL)
+		return c->idle_thread;
+
+	ready_remove (rq, t);
+	return t;
+}
+
+/* Returns the highest priority thread on RQ that may run on CPU,
+   without removing it, or a null pointer if there is none.  Among
+   equals, the one that has waited longest wins.  If MISPLACED,
+   only considers threads that may not run on RQ's own CPU. */
+static struct thread *
+rq_pick (struct runqueue *rq, int cpu, bool misplaced) {
+	uint64_t mask = rq->mask;
+
+	while (mask != 0) {
+		int pri = 63 - __builtin_clzll (mask);
+		struct list *q = &rq->queues[pri];
+
+		for (struct list_elem *e = list_begin (q); e != list_end (q);
+				e = list_next (e)) {
+			struct thread *t = list_entry (e, struct thread, elem);
+			if (cpu_allowed (t, cpu)
+					&& !(misplaced && cpu_allowed (t, rq - runqueues)))
+				return t;
+		}
+		mask &= ~(1ULL << pri);
+	}
+	return NULL;
+}
+
+/* Returns the amount of work on CPU: its ready threads, plus one
+   if it is running something other than its idle thread.  Read
+   without locking, so only an estimate. */
+static size_t
+cpu_load (int cpu) {
+	return runqueues[cpu].cnt + (cpus[cpu].curr != cpus[cpu].idle_thread);
+}
+
+/* Picks the CPU a new thread with the given AFFINITY starts on:
+   the allowed one with the least work.  Ties go to the running
+   CPU. */
+static int
+select_cpu (unsigned affinity) {
+	enum intr_level old_level = intr_disable ();
+	int best = cpu_current ()->id;
+	size_t best_load = SIZE_MAX;
+
+	for (int i = 0; i < cpu_cnt; i++) {
+		size_t load;
+
+		if (!((affinity >> i) & 1))
+			continue;
+		load = cpu_load (i);
+		if (load < best_load || (load == best_load && i == best)) {
+			best = i;
+			best_load = load;
+		}
+	}
+	intr_set_level (old_level);
+	return best;
+}
+
+/* Moves one thread that may run on CPU C from another CPU's run
+   queue to RQ, C's own, whose lock must be held, and returns it;
+   or returns a null pointer.  Misplaced threads are taken first.
+   Otherwise the source is the busiest CPU, and unless C is IDLE
+   it must have at least two more threads than C, so that moving
+   one does not just move the imbalance.
+
+   The source's lock is only tried, never waited for: two CPUs
+   stealing from each other could otherwise deadlock.  This also
+   keeps us off a queue whose CPU is in the middle of a switch,
+   when its previous thread is queued but not yet saved. */
+static struct thread *
+steal_thread (struct runqueue *rq, struct cpu *c, bool idle) {
+	struct runqueue *src = NULL;
+	size_t src_load = 0;
+	struct thread *t;
+
+	ASSERT (spinlock_held_by_current_cpu (&rq->lock));
+
+	for (int i = 0; i < cpu_cnt; i++) {
+		size_t load;
+
+		if (i == c->id || runqueues[i].cnt == 0)
+			continue;
+		if (runqueues[i].misplaced > 0) {
+			src = &runqueues[i];
+			src_load = SIZE_MAX;
+			break;
+		}
+		load = cpu_load (i);
+		if (load > src_load) {
+			src = &runqueues[i];
+			src_load = load;
+		}
+	}
+	if (src == NULL || (!idle && src_load < cpu_load (c->id) + 2))
+		return NULL;
+	if (!spinlock_try_acquire (&src->lock))
+		return NULL;
+
+	/* If none of SRC's misplaced threads may run here, an ordinary
+	   one may still be taken, but only on the same terms as from
+	   any other busy CPU. */
+	t = rq_pick (src, c->id, src_load == SIZE_MAX);
+	if (t == NULL && src_load == SIZE_MAX
+			&& (idle || cpu_load (src - runqueues) >= cpu_load (c->id) + 2))
+		t = rq_pick (src, c->id, false);
+	if (t != NULL) {
+		ready_remove (src, t);
+		t->cpu = c->id;
+		ready_push (rq, t);
+		mlfqs_catch_up (rq, t);
+	}
+	spinlock_release (&src->lock);
+	return t;
+}
+
+/* Periodic load balancing for CPU C, from the timer tick.  Pulls
+   one thread from a busier CPU and, if it should run before what
+   C is running, arranges to switch to it. */
+static void
+load_balance (struct cpu *c) {
+	struct runqueue *rq = &runqueues[c->id];
+	struct thread *t;
+	bool idle = c->curr == c->idle_thread;
+
+	ASSERT (intr_context ());
+
+	spinlock_acquire (&rq->lock);
+	t = steal_thread (rq, c, idle);
+	if (t != NULL && (idle || t->priority > c->curr->priority))
+		intr_yield_on_return ();
+	spinlock_release (&rq->lock);
+}
+
+/* Locks and returns the run queue of T's CPU.  T->cpu can only
+   change while T is ready and its run queue is locked, so after
+   locking we check that it still names the same queue.
+   Interrupts must be off. */
+static struct runqueue *
+thread_rq_lock (struct thread *t) {
+	for (;;) {
+		struct runqueue *rq = &runqueues[t->cpu];
+
+		spinlock_acquire (&rq->lock);
+		if (rq == &runqueues[t->cpu])
+			return rq;
+		spinlock_release (&rq->lock);
+	}
+}
+
+/* Appends T to the tail of RQ's queue for its priority. */
+static void
+ready_push (struct runqueue *rq, struct thread *t) {
+	ASSERT (spinlock_held_by_current_cpu (&rq->lock));
+	ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	list_push_back (&rq->queues[t->priority], &t->elem);
+	rq->mask |= 1ULL << t->priority;
+	rq->cnt++;
+	if (!cpu_allowed (t, rq - runqueues))
+		rq->misplaced++;
+}
+
+/* Removes T from RQ's queue for its priority.  T->priority must
+   not have changed since T was pushed. */
+static void
+ready_remove (struct runqueue *rq, struct thread *t) {
+	ASSERT (spinlock_held_by_current_cpu (&rq->lock));
+
+	list_remove (&t->elem);
+	if (list_empty (&rq->queues[t->priority]))
+		rq->mask &= ~(1ULL << t->priority);
+	rq->cnt--;
+	if (!cpu_allowed (t, rq - runqueues))
+		rq->misplaced--;
+}
+
+/* Applies the MLFQS epochs that T, filed on RQ, has missed to its
+   recent_cpu and refiles it if that changes its priority.  Returns
+   true if T was refiled. */
+static bool
+mlfqs_catch_up (struct runqueue *rq, struct thread *t) {
+	int priority;
+
+	if (!thread_mlfqs || is_idle_thread (t)
+			|| t->recent_cpu_epoch == mlfqs_epoch)
+		return false;
+	calc_recent_cpu (t);
+	priority = mlfqs_priority (t);
+	if (priority == t->priority)
+		return false;
+	ready_remove (rq, t);
+	t->priority = priority;
+	ready_push (rq, t);
+	return true;
+}
+
+/* Returns the highest priority among RQ's ready threads, or -1 if
+   there are none. */
+static int
+ready_max_priority (const struct runqueue *rq) {
+	uint64_t mask = rq->mask;
+
+	if (mask == 0)
+		return -1;
+	return 63 - __builtin_clzll (mask);
+}
+
+/* T has just been made ready on its CPU's run queue.  If that is
+   another CPU and T should run there before what it is running
+   now, interrupts it so that it reschedules. */
+static void
+kick_cpu (struct thread *t) {
+	struct cpu *c = &cpus[t->cpu];
+
+	if (c != cpu_current () && cpu_allowed (t, t->cpu)
+			&& (c->curr == c->idle_thread || t->priority > c->curr->priority))
+		smp_send_resched (c);
+}
+
+/* Sets T's effective priority to PRIORITY.  If T is on the ready
+   queue it is moved to the tail of the queue for its new
+   priority, so donations and MLFQS recomputation never leave a
+   thread filed under a stale level. */
+void
+thread_change_priority (struct thread *t, int priority) {
+	enum intr_level old_level;
+	struct runqueue *rq;
+
+	ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+	old_level = intr_disable ();
+	rq = thread_rq_lock (t);
+	if (t->priority != priority) {
+		if (t->status == THREAD_READY) {
+			ready_remove (rq, t);
+			t->priority = priority;
+			ready_push (rq, t);
+			kick_cpu (t);
+		} else
+			t->priority = priority;
+	}
+	spinlock_release (&rq->lock);
+	intr_set_level (old_level);
 }
 
 /* Use iretq to launch the thread */
 void
 do_iret (struct intr_frame *tf) {
 	__asm __volatile(
+			"cli\n"
 			"movq %0, %%rsp\n"
 			"movq 0(%%rsp),%%r15\n"
 			"movq 8(%%rsp),%%r14\n"
@@ -554,6 +1054,12 @@ do_iret (struct intr_frame *tf) {
 			"movw 8(%%rsp),%%ds\n"
 			"movw (%%rsp),%%es\n"
 			"addq $32, %%rsp\n"
+			/* Entering user mode: park this CPU's %gs base.
+			   See threads/cpu.h. */
+			"testb $3, 8(%%rsp)\n"
+			"jz 1f\n"
+			"swapgs\n"
+			"1:\n"
 			"iretq"
 			: : "g" ((uint64_t) tf) : "memory");
 }
@@ -629,34 +1135,59 @@ thread_launch (struct thread *th) {
 
 /* Schedules a new process. At entry, interrupts must be off.
  * This function modify current thread's status to status and then
- * finds another thread to run and switches to it.
+ * finds another thread to run and switches to it.  A thread that
+ * yields (STATUS is THREAD_READY) goes back on this CPU's run
+ * queue.
  * It's not safe to call printf() in the schedule(). */
 static void
 do_schedule(int status) {
+	struct cpu *c = cpu_current ();
+	struct thread *curr = running_thread ();
+	struct runqueue *rq = &runqueues[c->id];
+
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (thread_current()->status == THREAD_RUNNING);
-	while (!list_empty (&destruction_req)) {
+	while (!list_empty (&c->destruction_req)) {
 		struct thread *victim =
-			list_entry (list_pop_front (&destruction_req), struct thread, elem);
+			list_entry (list_pop_front (&c->destruction_req), struct thread, elem);
 		palloc_free_page(victim);
 	}
-	thread_current ()->status = status;
+
+	spinlock_acquire (&rq->lock);
+	if (status == THREAD_BLOCKED && curr->wake_pending) {
+		/* Already woken up by another CPU. */
+		curr->wake_pending = false;
+		spinlock_release (&rq->lock);
+		return;
+	}
+	if (status == THREAD_READY && curr != c->idle_thread)
+		ready_push (rq, curr);
+	curr->status = status;
 	schedule ();
 }
 
+/* Switches this CPU to the next thread on its run queue.  The
+   run queue's lock must be held; it is released on the other
+   side of the switch, by schedule_tail(). */
 static void
 schedule (void) {
+	struct cpu *c = cpu_current ();
+	struct runqueue *rq = &runqueues[c->id];
 	struct thread *curr = running_thread ();
-	struct thread *next = next_thread_to_run ();
+	struct thread *next = next_thread_to_run (rq, c);
 
 	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (spinlock_held_by_current_cpu (&rq->lock));
 	ASSERT (curr->status != THREAD_RUNNING);
 	ASSERT (is_thread (next));
+	if (curr == c->idle_thread)
+		timer_idle_exit ();
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
+	c->curr = next;
 
 	/* Start new time slice. */
-	thread_ticks = 0;
+	c->thread_ticks = 0;
 
 #ifdef USERPROG
 	/* Activate the new address space. */
@@ -673,13 +1204,23 @@ schedule (void) {
 		   schedule(). */
 		if (curr && curr->status == THREAD_DYING && curr != initial_thread) {
 			ASSERT (curr != next);
-			list_push_back (&destruction_req, &curr->elem);
+			list_push_back (&c->destruction_req, &curr->elem);
 		}
 
 		/* Before switching the thread, we first save the information
 		 * of current running. */
 		thread_launch (next);
 	}
+	schedule_tail ();
+}
+
+/* Completes a switch to the running thread by releasing the run
+   queue lock that the previous thread took in do_schedule().  We
+   may have been switched out on a different CPU, so the lock is
+   looked up afresh. */
+static void
+schedule_tail (void) {
+	spinlock_release (&runqueues[cpu_current ()->id].lock);
 }
 
 /* Returns a tid to use for a new thread. */
@@ -688,21 +1229,24 @@ allocate_tid (void) {
 	static tid_t next_tid = 1;
 	tid_t tid;
 
-	lock_acquire (&tid_lock);
+	mutex_lock (&tid_lock);
 	tid = next_tid++;
-	lock_release (&tid_lock);
+	mutex_unlock (&tid_lock);
 
 	return tid;
 }
 
-/* global_ticks getter and setter */
-void set_global_ticks() {
-	struct list_elem *front = list_begin(&sleep_list); 
-	struct thread *tmp = list_entry(front, struct thread, elem);
-	global_ticks = MIN(tmp->local_ticks,global_ticks);
+/* global_ticks getter and setter.
+   Must be called whenever the heap's minimum may have changed, so
+   that global_ticks is always the exact next deadline (it can move
+   later as well as earlier). */
+void set_global_ticks(void) {
+	struct heap_elem *min = heap_min (&sleep_heap);
 
-	// struct thread *tmp = list_min(&sleep_list,ticks_less,NULL);
-	// global_ticks = MIN(tmp->local_ticks,global_ticks);
+	if (min == NULL)
+		global_ticks = INT64_MAX;
+	else
+		global_ticks = heap_entry (min, struct thread, sleep_elem)->local_ticks;
 }
 
 /* get global_ticks to track the next thread to wake up */
@@ -711,11 +1255,11 @@ int64_t get_global_ticks(void) {
 }
 
 bool
-ticks_less(const struct list_elem *a_, const struct list_elem *b_,
+ticks_less(const struct heap_elem *a_, const struct heap_elem *b_,
             void *aux UNUSED)
 {
-    const struct thread *a = list_entry(a_, struct thread, elem);
-    const struct thread *b = list_entry(b_, struct thread, elem);
+    const struct thread *a = heap_entry(a_, struct thread, sleep_elem);
+    const struct thread *b = heap_entry(b_, struct thread, sleep_elem);
 
     return a->local_ticks < b->local_ticks;
 }
@@ -735,22 +1279,18 @@ preempt() {
 	// 현재 running 중인 thread와 ready 리스트에 있는 스레드 비교를 해야함
 	struct thread *cur = thread_current();
 
-	if (list_empty(&ready_list)) {
-		return;
-	}
-	if (cur == idle_thread) {
+	if (is_idle_thread (cur)) {
 		return;
 	}
-	if (cur->priority < list_entry(list_front(&ready_list), struct thread, elem)->priority) { 
+	if (cur->priority < ready_max_priority (&runqueues[cur->cpu])) {
 		thread_yield();
 	}
 }
 
-void
-calc_priority(struct thread *cur) {
-	// In every fourth tick, recompute the priority of all threads
-	// priority = PRI_MAX – (recent_cpu / 4) – (nice * 2)
-	if(cur==idle_thread) return;
+/* MLFQS priority of T:
+   priority = PRI_MAX – (recent_cpu / 4) – (nice * 2), clamped. */
+static int
+mlfqs_priority (const struct thread *cur) {
 	int tmp = fixed_to_int_trunc (
 		fixed_add_int(fixed_div_int (cur->recent_cpu, -4),
 	  	PRI_MAX - cur->nice * 2)
@@ -760,61 +1300,78 @@ calc_priority(struct thread *cur) {
 	} else if (tmp < PRI_MIN) {
 		tmp = PRI_MIN;
 	}
-	cur->priority = tmp;
+	return tmp;
 }
 
 void
-calc_all_priority() {
-	// In every fourth tick, recompute the priority of all threads
-	// priority = PRI_MAX – (recent_cpu / 4) – (nice * 2)
-	struct list_elem *e;
-	struct thread *cur;
-    for (e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e)) {
-    	cur = list_entry (e, struct thread, allelem); 
-		calc_priority(cur);
-	}
+calc_priority(struct thread *cur) {
+	// In every fourth tick, recompute the priority of the running thread.
+	// Nobody else's recent_cpu or nice changed since the last epoch.
+	if(is_idle_thread (cur)) return;
+	thread_change_priority (cur, mlfqs_priority (cur));
 }
 
 void
-calc_load_avg() {
-	int ready_threads;
-  
-  	if (thread_current () == idle_thread)
-    	ready_threads = list_size (&ready_list);
-  	else
-    	ready_threads = list_size (&ready_list) + 1;
+calc_load_avg(void) {
+	int ready_threads = 0;
+
+	for (int i = 0; i < cpu_cnt; i++) {
+		ready_threads += runqueues[i].cnt;
+		if (cpus[i].curr != cpus[i].idle_thread)
+			ready_threads++;
+	}
 
+	seqlock_write_begin (&load_avg_seq);
   	load_avg = fixed_add(fixed_mul (  ((59*F)/60) , load_avg), 
                			 fixed_mul_int ( ((F)/60)  , ready_threads));
+	seqlock_write_end (&load_avg_seq);
 }
 
+/* Starts a new MLFQS epoch (one per second).  Instead of decaying
+   every thread's recent_cpu, the epoch's decay factor is recorded
+   and applied lazily by calc_recent_cpu() the next time a thread
+   matters to the scheduler.  Only the running thread is brought
+   up to date now.  Ready threads catch up when they are picked to
+   run, in next_thread_to_run() or steal_thread(), and blocked
+   threads when they are unblocked. */
 void
-calc_all_recent_cpu() {
+calc_all_recent_cpu(void) {
 	// In every second, update every thread’s recent_cpu
 	// recent_cpu = decay * recent_cpu + nice,
-	struct list_elem *e;
-	struct thread *cur;
-    for (e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e)) {
-    	cur = list_entry (e, struct thread, allelem);
-		calc_recent_cpu(cur);
-	}
+	int tmp = fixed_mul_int(load_avg,2);
+
+	mlfqs_epoch++;
+	decay_hist[mlfqs_epoch % DECAY_HIST] = fixed_div(tmp , fixed_add_int(tmp,1));
+
+	calc_recent_cpu (thread_current ());
 }
 
+/* Applies the decays of the epochs CUR has missed to its
+   recent_cpu.  A thread that slept through more than DECAY_HIST
+   epochs only gets the most recent DECAY_HIST of them, by which
+   point the older history has long since decayed away. */
 void
 calc_recent_cpu(struct thread *cur) {
-	// In every second, update every thread’s recent_cpu
-	// recent_cpu = decay * recent_cpu + nice,
-	if (cur == idle_thread) return;
-	int tmp = fixed_mul_int(load_avg,2);
-	int decay = fixed_div(tmp , fixed_add_int(tmp,1));
-	int ret = fixed_add_int(fixed_mul(decay , cur->recent_cpu) , cur->nice);
-	if ((ret >> 31) == (-1) >> 31) {
-		ret = 0;
+	// recent_cpu = decay * recent_cpu + nice, once per missed epoch
+	unsigned missed = mlfqs_epoch - cur->recent_cpu_epoch;
+
+	cur->recent_cpu_epoch = mlfqs_epoch;
+	if (is_idle_thread (cur)) return;
+	if (missed > DECAY_HIST)
+		missed = DECAY_HIST;
+
+	for (unsigned e = mlfqs_epoch - missed + 1; missed > 0; e++, missed--) {
+		int decay = decay_hist[e % DECAY_HIST];
+		int ret = fixed_add_int(fixed_mul(decay , cur->recent_cpu) , cur->nice);
+		if ((ret >> 31) == (-1) >> 31) {
+			ret = 0;
+		}
+		cur->recent_cpu = ret;
 	}
-	cur->recent_cpu = ret;
 }
+
 void
-incr_recent_cpu() {
+incr_recent_cpu(void) {
 	// In every clock tick, increase the running thread’s recent_cpu by one.
 	struct thread * cur = thread_current();
 	cur->recent_cpu = fixed_add_int( cur->recent_cpu, 1 );
@@ -0,0 +1,149 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The vmalloc() region lies in the kernel half of base_pml4,
+   under a page-map-level-4 entry that paging_init() has already
+   filled in and that every process page table copies, so
+   mappings made here appear in all of them at once.
+
+   Each allocation takes one more page of the region than it maps.
+   The unmapped page after it catches overruns, and marks its end
+   for vfree(). */
+
+/* Pages of the region in use, including guard pages. */
+static struct bitmap *region_map;
+static uint64_t region_map_buf[VMALLOC_PAGES / 64 + 4];
+static struct lock region_lock;
+
+static void unmap_pages (uint8_t *va, size_t page_cnt);
+
+/* Initializes the vmalloc() region.  Must be called after
+   paging_init(). */
+void
+vmalloc_init (void) {
+	ASSERT (bitmap_buf_size (VMALLOC_PAGES) <= sizeof region_map_buf);
+
+	region_map = bitmap_create_in_buf (VMALLOC_PAGES, region_map_buf,
+			sizeof region_map_buf);
+	lock_init (&region_lock);
+}
+
+/* Obtains and returns a page-aligned block of at least SIZE
+   bytes, which may span physically scattered pages.  Returns a
+   null pointer if memory or address space is not available. */
+void *
+vmalloc (size_t size) {
+	size_t page_cnt, idx, i;
+	uint8_t *va;
+
+	if (size == 0)
+		return NULL;
+	page_cnt = DIV_ROUND_UP (size, PGSIZE);
+	if (page_cnt >= VMALLOC_PAGES)
+		return NULL;
+
+	lock_acquire (&region_lock);
+	idx = bitmap_scan_and_flip (region_map, 0, page_cnt + 1, false);
+	lock_release (&region_lock);
+	if (idx == BITMAP_ERROR)
+		return NULL;
+
+	va = (uint8_t *) VMALLOC_BASE + PGSIZE * idx;
+	for (i = 0; i < page_cnt; i++) {
+		void *kpage = palloc_get_page (0);
+
+		if (kpage == NULL || !kern_set_page (va + PGSIZE * i, kpage)) {
+			if (kpage != NULL)
+				palloc_free_page (kpage);
+			unmap_pages (va, i);
+			lock_acquire (&region_lock);
+			bitmap_set_multiple (region_map, idx, page_cnt + 1, false);
+			lock_release (&region_lock);
+			return NULL;
+		}
+	}
+	return va;
+}
+
+/* Allocates and returns A times B bytes initialized to zeroes
+   with vmalloc().  Returns a null pointer if memory is not
+   available. */
+void *
+vcalloc (size_t a, size_t b) {
+	void *p;
+	size_t size;
+
+	/* Calculate block size and make sure it fits in size_t. */
+	size = a * b;
+	if (a != 0 && size / a != b)
+		return NULL;
+
+	p = vmalloc (size);
+	if (p != NULL)
+		memset (p, 0, size);
+	return p;
+}
+
+/* Frees block P, which must have been previously allocated with
+   vmalloc() or vcalloc(). */
+void
+vfree (void *p) {
+	uint8_t *va = p;
+	size_t idx, page_cnt;
+
+	if (p == NULL)
+		return;
+	ASSERT (is_vmalloc_vaddr (p));
+	ASSERT (pg_ofs (p) == 0);
+
+	/* Count pages up to the guard page. */
+	for (page_cnt = 0; kern_get_page (va + PGSIZE * page_cnt) != NULL;
+			page_cnt++)
+		continue;
+	ASSERT (page_cnt > 0);
+
+	unmap_pages (va, page_cnt);
+
+	idx = pg_no (va) - pg_no (VMALLOC_BASE);
+	lock_acquire (&region_lock);
+	ASSERT (bitmap_all (region_map, idx, page_cnt + 1));
+	bitmap_set_multiple (region_map, idx, page_cnt + 1, false);
+	lock_release (&region_lock);
+}
+
+/* Unmaps the PAGE_CNT pages at VA and frees the pages behind
+   them.  Another CPU may still have the old mappings cached, and
+   write through them to a page that palloc has handed out again,
+   so the pages are freed only after every TLB is flushed.  Until
+   then they are kept on a list threaded through their first
+   words. */
+static void
+unmap_pages (uint8_t *va, size_t page_cnt) {
+	void *kpages = NULL;
+	size_t i;
+
+	if (page_cnt == 0)
+		return;
+
+	for (i = 0; i < page_cnt; i++) {
+		void *kpage = kern_clear_page (va + PGSIZE * i);
+
+		*(void **) kpage = kpages;
+		kpages = kpage;
+	}
+	smp_flush_tlb ();
+	while (kpages != NULL) {
+		void *next = *(void **) kpages;
+
+		palloc_free_page (kpages);
+		kpages = next;
+	}
+}
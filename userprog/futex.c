@@ -0,0 +1,229 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <plist.h>
+#include <round.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "filesys/file.h"
+#include "vm/vm.h"
+#endif
+
+/* Fast user-space mutexes.
+
+   A user program keeps its lock or condition word in its own
+   memory and enters the kernel only to sleep on the word or to
+   wake its sleepers.  Sleepers are keyed by what the word is, not
+   where it happens to be in memory: a word in a file mapping by
+   the file and its offset in it, so that processes mapping the
+   file meet on the same queue whatever their addresses, and any
+   other word by the address space and its address.  Neither
+   changes when the word's page is evicted and read back into
+   another frame, or has not been brought in yet.
+
+   Sleepers hang off a fixed hash table of buckets.  A bucket's
+   lock is held while futex_wait() compares the word with the
+   value the caller expects and queues itself, and while
+   futex_wake() dequeues, so a wake-up that follows a store to the
+   word cannot slip in between the comparison and the sleep. */
+
+#define FUTEX_BUCKETS 64        /* Number of hash buckets. */
+
+struct futex_bucket {
+	struct spinlock lock;       /* Protects waiters. */
+	struct plist waiters;       /* struct futex_waiter, by priority. */
+};
+
+/* Identity of a futex word. */
+struct futex_key {
+	const void *object;         /* Mapped file's inode, or page table. */
+	uint64_t offset;            /* Offset in the file, or user address. */
+};
+
+/* A thread sleeping in futex_wait().  Lives on its stack. */
+struct futex_waiter {
+	struct futex_key key;       /* Word slept on. */
+	struct thread *thread;      /* Sleeping thread. */
+	bool timed;                 /* Also on the sleep heap? */
+	bool woken;                 /* Dequeued by futex_wake()? */
+	struct plist_elem elem;     /* In bucket's waiters. */
+};
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+static bool futex_key (const uint32_t *uaddr, struct futex_key *key);
+static bool key_equal (const struct futex_key *, const struct futex_key *);
+static uint32_t *futex_word (uint32_t *uaddr);
+static struct futex_bucket *key_bucket (const struct futex_key *key);
+
+/* Initializes the futex table. */
+void
+futex_init (void) {
+	int i;
+
+	for (i = 0; i < FUTEX_BUCKETS; i++) {
+		spinlock_init (&buckets[i].lock);
+		plist_init (&buckets[i].waiters);
+	}
+}
+
+/* If the word at user address UADDR holds EXPECTED, sleeps until
+   futex_wake() is called on it, possibly through another mapping,
+   or until TIMEOUT_MS milliseconds have passed.  A negative
+   TIMEOUT_MS waits forever.  Returns 0 if woken, FUTEX_TIMEDOUT
+   if the time ran out, or FUTEX_MISMATCH at once if the word did
+   not hold EXPECTED or UADDR is not an aligned address in the
+   process's memory. */
+int
+futex_wait (uint32_t *uaddr, uint32_t expected, int64_t timeout_ms) {
+	struct thread *cur = thread_current ();
+	struct futex_waiter w;
+	struct futex_bucket *b;
+	enum intr_level old_level;
+	uint32_t *kaddr;
+	uint32_t value;
+	int64_t delay = 0;
+
+	if (!futex_key (uaddr, &w.key))
+		return FUTEX_MISMATCH;
+	w.thread = cur;
+	w.timed = timeout_ms >= 0;
+	w.woken = false;
+	if (w.timed)
+		delay = DIV_ROUND_UP (timeout_ms * TIMER_FREQ, 1000);
+
+	/* Read the word under the bucket lock.  If its page was evicted
+	   meanwhile, its frame may hold another page by now, so check
+	   that the word is still mapped where we read it, after the
+	   read, and otherwise go again. */
+	b = key_bucket (&w.key);
+	for (;;) {
+		kaddr = futex_word (uaddr);
+		if (kaddr == NULL)
+			return FUTEX_MISMATCH;
+		old_level = intr_disable ();
+		spinlock_acquire (&b->lock);
+		value = __atomic_load_n (kaddr, __ATOMIC_SEQ_CST);
+		if (pml4_get_page (cur->pml4, uaddr) == kaddr)
+			break;
+		spinlock_release (&b->lock);
+		intr_set_level (old_level);
+	}
+	if (value != expected || (w.timed && delay == 0)) {
+		spinlock_release (&b->lock);
+		intr_set_level (old_level);
+		return value != expected ? FUTEX_MISMATCH : FUTEX_TIMEDOUT;
+	}
+	plist_insert (&b->waiters, &w.elem, cur->priority);
+	/* On the sleep heap before futex_wake() can see us, so that
+	   it knows whether the timer has already woken us. */
+	if (w.timed)
+		thread_sleep_prepare (timer_ticks () + delay);
+	spinlock_release (&b->lock);
+	thread_block ();
+
+	spinlock_acquire (&b->lock);
+	if (!w.woken)
+		plist_remove (&b->waiters, &w.elem);
+	spinlock_release (&b->lock);
+	intr_set_level (old_level);
+	return w.woken ? 0 : FUTEX_TIMEDOUT;
+}
+
+/* Wakes up to N threads, highest priority first, sleeping in
+   futex_wait() on the word at user address UADDR.  Returns the
+   number woken, or -1 if UADDR is not an aligned user address.
+   The word's page need not be in memory. */
+int
+futex_wake (uint32_t *uaddr, int n) {
+	struct futex_bucket *b;
+	struct plist_elem *e, *next;
+	enum intr_level old_level;
+	struct futex_key key;
+	int cnt = 0;
+
+	if (!futex_key (uaddr, &key))
+		return -1;
+
+	b = key_bucket (&key);
+	old_level = intr_disable ();
+	spinlock_acquire (&b->lock);
+	for (e = plist_begin (&b->waiters); e != NULL && cnt < n; e = next) {
+		struct futex_waiter *w = plist_entry (e, struct futex_waiter, elem);
+
+		next = plist_next (&b->waiters, e);
+		if (!key_equal (&w->key, &key))
+			continue;
+		plist_remove (&b->waiters, &w->elem);
+		w->woken = true;
+		/* If the timer got to a timed waiter first, it is already
+		   awake and will find itself woken. */
+		if (!w->timed)
+			thread_unblock (w->thread);
+		else
+			thread_sleep_cancel (w->thread);
+		cnt++;
+	}
+	spinlock_release (&b->lock);
+	preempt ();
+	intr_set_level (old_level);
+	return cnt;
+}
+
+/* Stores in *KEY the identity of the word at user address UADDR
+   in the running process.  Returns false if UADDR is misaligned
+   or not a user address. */
+static bool
+futex_key (const uint32_t *uaddr, struct futex_key *key) {
+	struct thread *cur = thread_current ();
+#ifdef VM
+	struct vma *vma;
+#endif
+
+	if ((uint64_t) uaddr % sizeof *uaddr != 0 || !is_user_vaddr (uaddr))
+		return false;
+	key->object = cur->pml4;
+	key->offset = (uint64_t) uaddr;
+#ifdef VM
+	vma = vma_find (&cur->spt, uaddr);
+	if (vma != NULL && VM_TYPE (vma->type) == VM_FILE) {
+		key->object = file_get_inode (vma->file);
+		key->offset = vma->offset
+			+ ((const uint8_t *) uaddr - (const uint8_t *) vma->start);
+	}
+#endif
+	return true;
+}
+
+/* Returns true if A and B identify the same word. */
+static bool
+key_equal (const struct futex_key *a, const struct futex_key *b) {
+	return a->object == b->object && a->offset == b->offset;
+}
+
+/* Returns the kernel address of the word at user address UADDR in
+   the running process, first bringing its page into memory if
+   need be, or a null pointer if UADDR is in none of the process's
+   pages. */
+static uint32_t *
+futex_word (uint32_t *uaddr) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	uint32_t *kaddr = pml4_get_page (pml4, uaddr);
+
+#ifdef VM
+	if (kaddr == NULL && vm_claim_page (uaddr))
+		kaddr = pml4_get_page (pml4, uaddr);
+#endif
+	return kaddr;
+}
+
+/* Returns the bucket that sleepers on KEY are filed in. */
+static struct futex_bucket *
+key_bucket (const struct futex_key *key) {
+	return &buckets[hash_bytes (key, sizeof *key) % FUTEX_BUCKETS];
+}
@@ -4,12 +4,15 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
+static int sys_sched_setaffinity (tid_t, unsigned mask);
+static int sys_lockstat (bool reset);
 
 /* System call.
  *
@@ -35,12 +38,53 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
+
+	futex_init ();
 }
 
 /* The main system call interface */
 void
 syscall_handler (struct intr_frame *f UNUSED) {
+	switch (f->R.rax) {
+		case SYS_SCHED_SETAFFINITY:
+			f->R.rax = sys_sched_setaffinity (f->R.rdi, f->R.rsi);
+			return;
+		case SYS_FUTEX_WAIT:
+			f->R.rax = futex_wait ((uint32_t *) f->R.rdi, f->R.rsi, f->R.rdx);
+			return;
+		case SYS_FUTEX_WAKE:
+			f->R.rax = futex_wake ((uint32_t *) f->R.rdi, f->R.rsi);
+			return;
+		case SYS_LOCKSTAT:
+			f->R.rax = sys_lockstat (f->R.rdi);
+			return;
+	}
 	// TODO: Your implementation goes here.
 	printf ("system call!\n");
 	thread_exit ();
 }
+
+/* Restricts process PID, which must be the caller or 0 for the
+   caller, to the CPUs whose bits are set in MASK.  Returns 0 if
+   successful, -1 otherwise. */
+static int
+sys_sched_setaffinity (tid_t pid, unsigned mask) {
+	if (pid != 0 && pid != thread_tid ())
+		return -1;
+	return thread_set_affinity (mask) ? 0 : -1;
+}
+
+/* Prints the kernel's lock statistics and, if RESET, zeroes them.
+   Returns 0 if successful, -1 if the kernel was built without
+   LOCKSTAT. */
+static int
+sys_lockstat (bool reset UNUSED) {
+#ifdef LOCKSTAT
+	lockstat_print ();
+	if (reset)
+		lockstat_reset ();
+	return 0;
+#else
+	return -1;
+#endif
+}
@@ -1,7 +1,12 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <bitmap.h>
 #include "devices/disk.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,11 +22,56 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* The swap disk is an array of slots of one page, SLOT_SECTORS
+ * sectors each.  What costs on a disk is seeking, not
+ * transferring, so swap works in runs of adjacent slots:
+ *
+ *   - Eviction sends out up to SWAP_CLUSTER pages at once, the
+ *     victim and its neighbours in its process's address space, to
+ *     a run of free slots found next fit from where the last run
+ *     ended.  The pages go out in one sequential write, in address
+ *     order.
+ *
+ *   - A fault on a swapped-out page also reads the slots after its
+ *     own that hold the next pages of the same process, which the
+ *     last point makes likely, into free frames.  These pages stay
+ *     unmapped until touched, so that the statistics can tell
+ *     whether reading ahead paid off.
+ *
+ *   - A page read in keeps its slot while swap is at most half
+ *     full, so that if it is evicted again unchanged, it need not
+ *     be written.
+ *
+ * swap_lock guards the slot map, swap_pages[], the slot and
+ * readahead members of anonymous pages and the statistics.  The
+ * disk is read and written without it: a slot being written
+ * belongs to pages being evicted, whose pinned frames keep them
+ * from everyone else, and a slot being read belongs to a page
+ * that is not in memory, which only its owner, the running
+ * process, may bring in or free. */
+#define SLOT_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+static struct bitmap *swap_map;         /* Slots in use. */
+static struct page **swap_pages;        /* Page in each slot in use. */
+static size_t swap_slot_cnt;
+static size_t swap_cursor;              /* Where the next search starts. */
+static struct lock swap_lock;
+static struct swap_stats swap_stats;
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	swap_disk = disk_get (1, 1);
+	lock_init (&swap_lock);
+	if (swap_disk == NULL)
+		return;
+
+	swap_slot_cnt = disk_size (swap_disk) / SLOT_SECTORS;
+	swap_map = bitmap_create (swap_slot_cnt);
+	swap_pages = vcalloc (swap_slot_cnt, sizeof *swap_pages);
+	if (swap_map == NULL || swap_pages == NULL)
+		PANIC ("vm: no memory for %zu swap slots", swap_slot_cnt);
+	swap_stats.slot_cnt = swap_slot_cnt;
 }
 
 /* Initialize the file mapping */
@@ -31,22 +81,233 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->slot = SWAP_NONE;
+	anon_page->readahead = false;
+	return true;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Allocates a run of CNT free slots, searching from where the last
+ * run ended, so that successive runs go out in one pass over the
+ * disk.  Returns the first slot, or SWAP_NONE if there is no such
+ * run.  swap_lock must be held. */
+static size_t
+slot_alloc (size_t cnt) {
+	size_t slot = bitmap_scan_and_flip (swap_map, swap_cursor, cnt, false);
+
+	if (slot == BITMAP_ERROR)
+		slot = bitmap_scan_and_flip (swap_map, 0, cnt, false);
+	if (slot == BITMAP_ERROR)
+		return SWAP_NONE;
+	swap_cursor = slot + cnt < swap_slot_cnt ? slot + cnt : 0;
+	swap_stats.used_cnt += cnt;
+	return slot;
+}
+
+/* Frees PAGE's slot, if it has one.  swap_lock must be held. */
+static void
+slot_release (struct page *page) {
+	struct anon_page *anon_page = &page->anon;
+
+	if (anon_page->slot == SWAP_NONE)
+		return;
+	ASSERT (swap_pages[anon_page->slot] == page);
+	bitmap_reset (swap_map, anon_page->slot);
+	swap_pages[anon_page->slot] = NULL;
+	anon_page->slot = SWAP_NONE;
+	swap_stats.used_cnt--;
+}
+
+/* Reads SLOT into the page at KVA. */
+static void
+slot_read (size_t slot, void *kva) {
+	size_t i;
+
+	for (i = 0; i < SLOT_SECTORS; i++)
+		disk_read (swap_disk, slot * SLOT_SECTORS + i,
+				(uint8_t *) kva + i * DISK_SECTOR_SIZE);
+}
+
+/* Writes the page at KVA to SLOT. */
+static void
+slot_write (size_t slot, const void *kva) {
+	size_t i;
+
+	for (i = 0; i < SLOT_SECTORS; i++)
+		disk_write (swap_disk, slot * SLOT_SECTORS + i,
+				(const uint8_t *) kva + i * DISK_SECTOR_SIZE);
+}
+
+/* Swap in the page by read contents from the swap disk.  The
+ * following pages of the running process whose copies follow
+ * PAGE's in swap come in too, if there are free frames for them. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *ahead[SWAP_READAHEAD];
+	struct frame *ahead_frames[SWAP_READAHEAD];
+	size_t ahead_cnt = 0;
+	size_t i;
+
+	ASSERT (anon_page->slot != SWAP_NONE);
+
+	lock_acquire (&swap_lock);
+	for (i = 1; i <= SWAP_READAHEAD; i++) {
+		size_t slot = anon_page->slot + i;
+		struct page *next = spt_find_page (spt,
+				(uint8_t *) page->va + i * PGSIZE);
+
+		if (slot >= swap_slot_cnt || next == NULL
+				|| swap_pages[slot] != next || next->frame != NULL)
+			break;
+		ahead[ahead_cnt++] = next;
+	}
+	lock_release (&swap_lock);
+
+	/* Reading ahead is a guess, not worth evicting anything for. */
+	for (i = 0; i < ahead_cnt; i++)
+		if ((ahead_frames[i] = vm_get_free_frame ()) == NULL)
+			break;
+	ahead_cnt = i;
+
+	slot_read (anon_page->slot, kva);
+	for (i = 0; i < ahead_cnt; i++)
+		slot_read (anon_page->slot + 1 + i, ahead_frames[i]->kva);
+
+	lock_acquire (&swap_lock);
+	if (swap_stats.used_cnt > swap_slot_cnt / 2)
+		slot_release (page);
+	for (i = 0; i < ahead_cnt; i++)
+		ahead[i]->anon.readahead = true;
+	swap_stats.reads++;
+	swap_stats.readaheads += ahead_cnt;
+	lock_release (&swap_lock);
+
+	for (i = 0; i < ahead_cnt; i++)
+		vm_install_frame (ahead[i], ahead_frames[i]);
+	return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+	return anon_swap_out_cluster (&page, 1);
+}
+
+/* Swaps out the CNT anonymous pages in PAGES[], at most
+ * SWAP_CLUSTER, which must be in frames, unmapped, and in address
+ * order.  Those whose slot still holds their contents are not
+ * written.  The rest go to a run of adjacent slots, in one
+ * sequential write, or if swap is too fragmented for that, to
+ * slots wherever they are free.  The frames must be pinned and
+ * marked as being written.  Returns false, leaving every page in
+ * its frame, if swap is full. */
+bool
+anon_swap_out_cluster (struct page *pages[], size_t cnt) {
+	struct page *out[SWAP_CLUSTER];
+	size_t slots[SWAP_CLUSTER];
+	size_t out_cnt = 0;
+	size_t first, i;
+
+	ASSERT (cnt <= SWAP_CLUSTER);
+
+	if (swap_disk == NULL)
+		return false;
+
+	lock_acquire (&swap_lock);
+	for (i = 0; i < cnt; i++) {
+		struct page *page = pages[i];
+		struct frame *frame = page->frame;
+
+		if (page->anon.readahead) {
+			page->anon.readahead = false;
+			swap_stats.readahead_misses++;
+		}
+		if (page->anon.slot != SWAP_NONE
+				&& !pml4_is_dirty (frame->pml4, page->va))
+			continue;
+		slot_release (page);
+		out[out_cnt++] = page;
+	}
+	if (out_cnt == 0) {
+		lock_release (&swap_lock);
+		return true;
+	}
+
+	first = slot_alloc (out_cnt);
+	for (i = 0; i < out_cnt; i++) {
+		slots[i] = first != SWAP_NONE ? first + i : slot_alloc (1);
+		if (slots[i] == SWAP_NONE) {
+			while (i-- > 0) {
+				bitmap_reset (swap_map, slots[i]);
+				swap_stats.used_cnt--;
+			}
+			lock_release (&swap_lock);
+			return false;
+		}
+	}
+	for (i = 0; i < out_cnt; i++) {
+		out[i]->anon.slot = slots[i];
+		swap_pages[slots[i]] = out[i];
+	}
+	swap_stats.writes += out_cnt;
+	swap_stats.clusters++;
+	lock_release (&swap_lock);
+
+	for (i = 0; i < out_cnt; i++)
+		slot_write (slots[i], out[i]->frame->kva);
+	return true;
+}
+
+/* Reads into KVA the copy in swap of SRC, an anonymous page of
+ * another process that is not in memory, for fork.  The other
+ * process must be waiting for the fork.  Returns false if SRC has
+ * no copy in swap. */
+bool
+anon_swap_copy (struct page *src, void *kva) {
+	ASSERT (VM_TYPE (src->operations->type) == VM_ANON);
+	ASSERT (src->frame == NULL);
+
+	if (src->anon.slot == SWAP_NONE)
+		return false;
+	slot_read (src->anon.slot, kva);
+
+	lock_acquire (&swap_lock);
+	swap_stats.reads++;
+	lock_release (&swap_lock);
+	return true;
+}
+
+/* Counts a hit if PAGE was read ahead and this is its first
+ * touch. */
+void
+anon_readahead_hit (struct page *page) {
+	lock_acquire (&swap_lock);
+	if (page->anon.readahead) {
+		page->anon.readahead = false;
+		swap_stats.readahead_hits++;
+	}
+	lock_release (&swap_lock);
+}
+
+/* Stores a snapshot of the swap statistics in *STATS. */
+void
+swap_get_stats (struct swap_stats *stats) {
+	lock_acquire (&swap_lock);
+	*stats = swap_stats;
+	lock_release (&swap_lock);
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+	/* Frame first: an eviction under way may still give PAGE a
+	 * slot. */
+	vm_free_frame (page, false);
+
+	lock_acquire (&swap_lock);
+	if (page->anon.readahead)
+		swap_stats.readahead_misses++;
+	slot_release (page);
+	lock_release (&swap_lock);
 }
@@ -1,6 +1,10 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include <string.h>
+#include "threads/mmu.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
@@ -25,34 +29,78 @@ file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
 	/* Set up the handler */
 	page->operations = &file_ops;
 
-	struct file_page *file_page = &page->file;
+	struct file_page *file_page UNUSED = &page->file;
+	return true;
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	if (file_read_at (file_page->file, kva, file_page->read_bytes,
+				file_page->offset) != (off_t) file_page->read_bytes)
+		return false;
+	memset ((uint8_t *) kva + file_page->read_bytes, 0,
+			PGSIZE - file_page->read_bytes);
+	return true;
 }
 
 /* Swap out the page by writeback contents to the file. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	struct frame *frame = page->frame;
+
+	if (pml4_is_dirty (frame->pml4, page->va)) {
+		if (file_write_at (file_page->file, frame->kva, file_page->read_bytes,
+					file_page->offset) != (off_t) file_page->read_bytes)
+			return false;
+		pml4_set_dirty (frame->pml4, page->va, false);
+	}
+	return true;
 }
 
-/* Destory the file backed page. PAGE will be freed by the caller. */
+/* Destory the file backed page. PAGE will be freed by the caller.
+ * Writes the page back to its file first if it was written to. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	vm_free_frame (page, true);
 }
 
-/* Do the mmap */
+/* Do the mmap.  Maps LENGTH bytes of FILE from OFFSET at ADDR, as
+ * a single VMA: no pages are created until they are touched, so
+ * this takes the same time whatever LENGTH is.  Returns ADDR, or a
+ * null pointer on failure. */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	off_t file_len;
+	size_t read_bytes;
+
+	if (addr == NULL || pg_ofs (addr) != 0 || length == 0 || file == NULL
+			|| offset < 0 || offset % PGSIZE != 0)
+		return NULL;
+	file_len = file_length (file);
+	if (file_len == 0)
+		return NULL;
+
+	read_bytes = offset < file_len ? (size_t) (file_len - offset) : 0;
+	if (read_bytes > length)
+		read_bytes = length;
+	if (vma_map (&thread_current ()->spt, addr, length, VM_FILE, writable,
+				file, offset, read_bytes) == NULL)
+		return NULL;
+	return addr;
 }
 
-/* Do the munmap */
+/* Do the munmap.  ADDR must be the address of a mapping returned
+ * by do_mmap() that is still mapped; otherwise, does nothing. */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *vma = vma_find (spt, addr);
+
+	if (vma != NULL && vma->start == addr && VM_TYPE (vma->type) == VM_FILE)
+		vma_unmap (spt, vma);
 }
@@ -1,9 +1,74 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <hash.h>
+#include <string.h>
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 
+/* A node of a supplemental page table.  At the bottom level the
+ * slots hold pages, above it child nodes. */
+struct spt_node {
+	void *slots[SPT_FANOUT];        /* Children or pages, by index. */
+	unsigned cnt;                   /* Number of nonnull slots. */
+};
+
+_Static_assert ((uint64_t) 1 << (SPT_BITS * SPT_LEVELS) >= pg_no (KERN_BASE),
+		"SPT_LEVELS too small for the user address space");
+
+/* Pages and SPT nodes come from caches of their own.  free()
+ * knows slab objects, so vm_dealloc_page() can still free() a
+ * page. */
+static struct kmem_cache vm_page_cache;
+static struct kmem_cache spt_node_cache;
+
+/* The frame table: one struct frame for each page of the user
+ * pool, in address order, so that a frame is found from its kva
+ * by arithmetic.  A frame is in use while it has a page.
+ *
+ * frame_lock guards the frames' pages, pml4s, pin and writing
+ * flags, the clock hand and the statistics.  It is not held while
+ * a page is written out, which may take many disk writes: the
+ * page's frame is pinned and marked as writing instead, and
+ * unmapped if it is being evicted.  A fault on such a page, or
+ * anything else that needs its frame, waits on that frame until
+ * the write is over (see vm_wait_frame()), and then finds the
+ * page either out or back in its frame. */
+static struct frame *frames;
+static size_t frame_cnt;
+static uint8_t *frame_base;
+static struct lock frame_lock;
+static struct frame_stats frame_stats;
+
+static void frame_table_init (void);
+
+/* A page replacement policy.  Its functions are called with
+ * frame_lock held. */
+struct evict_policy {
+	const char *name;                       /* As given to -evict=. */
+	void (*init) (void);                    /* Set up, at boot. */
+	void (*admit) (struct frame *);         /* FRAME was given a page. */
+	void (*release) (struct frame *);       /* FRAME's page was freed. */
+	struct frame *(*victim) (void);         /* Pick a frame to evict. */
+	void (*evicted) (struct frame *);       /* Its page was evicted. */
+	void (*spared) (struct frame *);        /* Its page could not be. */
+	void (*forget) (uint64_t *pml4);        /* PML4's process is exiting. */
+};
+
+static const struct evict_policy clock_policy;
+static const struct evict_policy twoq_policy;
+static const struct evict_policy *const evict_policies[] = {
+	&clock_policy, &twoq_policy,
+};
+
+/* Replacement policy in use, set by "-evict". */
+static const struct evict_policy *evict_policy = &clock_policy;
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -15,7 +80,55 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	kmem_cache_init (&vm_page_cache, "page", sizeof (struct page), NULL);
+	kmem_cache_init (&spt_node_cache, "spt node", sizeof (struct spt_node),
+			NULL);
+	vma_init ();
+	frame_table_init ();
+}
+
+/* Sets up the frame table, with every frame free. */
+static void
+frame_table_init (void) {
+	size_t i;
+
+	palloc_user_pool ((void **) &frame_base, &frame_cnt);
+	frames = vcalloc (frame_cnt, sizeof *frames);
+	if (frames == NULL)
+		PANIC ("vm: no memory for a frame table of %zu frames", frame_cnt);
+	for (i = 0; i < frame_cnt; i++) {
+		frames[i].kva = frame_base + i * PGSIZE;
+		cond_init (&frames[i].written);
+	}
+	lock_init (&frame_lock);
+	frame_stats.frame_cnt = frame_cnt;
+	frame_stats.policy = evict_policy->name;
+	evict_policy->init ();
+}
+
+/* Selects the page replacement policy called NAME, "clock" or
+ * "2q".  Returns false if there is no such policy.  Must be called
+ * before vm_init(). */
+bool
+vm_set_evict_policy (const char *name) {
+	size_t i;
+
+	for (i = 0; i < sizeof evict_policies / sizeof *evict_policies; i++)
+		if (name != NULL && !strcmp (name, evict_policies[i]->name)) {
+			evict_policy = evict_policies[i];
+			return true;
+		}
+	return false;
+}
+
+/* Returns the frame for KVA, a page of the user pool. */
+static struct frame *
+frame_of (void *kva) {
+	size_t idx = ((uint8_t *) kva - frame_base) / PGSIZE;
+
+	ASSERT (pg_ofs (kva) == 0);
+	ASSERT (idx < frame_cnt);
+	return &frames[idx];
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -35,6 +148,9 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
+static void vm_unpin (struct frame *);
+static struct frame *vm_wait_frame (struct page *page);
+static void vm_end_write (struct frame *);
 static struct frame *vm_evict_frame (void);
 
 /* Create the pending page object with initializer. If you want to create a
@@ -50,77 +166,754 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+		bool (*initializer) (struct page *, enum vm_type, void *);
+		struct page *page;
+
+		switch (VM_TYPE (type)) {
+			case VM_ANON:
+				initializer = anon_initializer;
+				break;
+			case VM_FILE:
+				initializer = file_backed_initializer;
+				break;
+			default:
+				goto err;
+		}
+
+		page = kmem_cache_alloc (&vm_page_cache);
+		if (page == NULL)
+			goto err;
+		uninit_new (page, upage, init, type, aux, initializer);
+		page->writable = writable;
 
-		/* TODO: Insert the page into the spt. */
+		if (!spt_insert_page (spt, page)) {
+			kmem_cache_free (&vm_page_cache, page);
+			goto err;
+		}
+		return true;
 	}
 err:
 	return false;
 }
 
+/* Returns the slot index for page number PG_NO in a node at
+ * LEVEL of a supplemental page table, the top being level 0. */
+static inline size_t
+spt_index (uint64_t pg_no, int level) {
+	return (pg_no >> (SPT_BITS * (SPT_LEVELS - 1 - level))) & (SPT_FANOUT - 1);
+}
+
+/* Frees the nodes on PATH[], from LEVEL up, that have become empty
+ * on the way to page number PG_NO. */
+static void
+spt_prune (struct supplemental_page_table *spt, uint64_t pg_no,
+		struct spt_node *path[SPT_LEVELS], int level) {
+	for (; level >= 0 && path[level]->cnt == 0; level--) {
+		kmem_cache_free (&spt_node_cache, path[level]);
+		if (level == 0)
+			spt->root = NULL;
+		else {
+			path[level - 1]->slots[spt_index (pg_no, level - 1)] = NULL;
+			path[level - 1]->cnt--;
+		}
+	}
+}
+
+/* Walks SPT down to the bottom node for page number PG_NO,
+ * storing the node at each level in PATH[].  If CREATE, missing
+ * nodes are added on the way.  Returns the bottom node, or a null
+ * pointer if it is missing or could not be allocated.  In the
+ * latter case, the nodes added are freed again. */
+static struct spt_node *
+spt_walk (struct supplemental_page_table *spt, uint64_t pg_no, bool create,
+		struct spt_node *path[SPT_LEVELS]) {
+	struct spt_node **slot = &spt->root;
+	int level;
+
+	for (level = 0; level < SPT_LEVELS; level++) {
+		if (*slot == NULL) {
+			if (!create)
+				return NULL;
+			*slot = kmem_cache_zalloc (&spt_node_cache);
+			if (*slot == NULL) {
+				if (level > 0)
+					spt_prune (spt, pg_no, path, level - 1);
+				return NULL;
+			}
+			if (level > 0)
+				path[level - 1]->cnt++;
+		}
+		path[level] = *slot;
+		if (level < SPT_LEVELS - 1)
+			slot = (struct spt_node **) &(*slot)->slots[spt_index (pg_no, level)];
+	}
+	return path[SPT_LEVELS - 1];
+}
+
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	uint64_t pg_no = pg_no (va);
+	struct spt_node *node = spt->root;
+	int level;
 
-	return page;
+	if (!is_user_vaddr (va))
+		return NULL;
+	for (level = 0; node != NULL && level < SPT_LEVELS - 1; level++)
+		node = node->slots[spt_index (pg_no, level)];
+	return node != NULL ? node->slots[spt_index (pg_no, SPT_LEVELS - 1)] : NULL;
 }
 
-/* Insert PAGE into spt with validation. */
+/* Insert PAGE into spt with validation.  Fails if PAGE's address
+ * is taken or memory for the tree is short. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
+spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
+	struct spt_node *path[SPT_LEVELS];
+	struct spt_node *node;
+	uint64_t pg_no = pg_no (page->va);
+	size_t idx = spt_index (pg_no, SPT_LEVELS - 1);
 
-	return succ;
+	ASSERT (pg_ofs (page->va) == 0);
+
+	if (!is_user_vaddr (page->va))
+		return false;
+	node = spt_walk (spt, pg_no, true, path);
+	if (node == NULL || node->slots[idx] != NULL)
+		return false;
+	node->slots[idx] = page;
+	node->cnt++;
+	spt->page_cnt++;
+	return true;
 }
 
+/* Removes PAGE from SPT and deallocates it. */
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	struct spt_node *path[SPT_LEVELS];
+	struct spt_node *node;
+	uint64_t pg_no = pg_no (page->va);
+	size_t idx = spt_index (pg_no, SPT_LEVELS - 1);
+
+	node = spt_walk (spt, pg_no, false, path);
+	ASSERT (node != NULL && node->slots[idx] == page);
+
+	node->slots[idx] = NULL;
+	node->cnt--;
+	spt->page_cnt--;
+	spt_prune (spt, pg_no, path, SPT_LEVELS - 1);
 	vm_dealloc_page (page);
+}
+
+/* Deallocates the pages under *SLOT, a node at LEVEL whose first
+ * page number is BASE, with page numbers in [LO, HI), and frees
+ * the nodes that this leaves empty.  Returns the number of pages
+ * removed. */
+static size_t
+spt_clear (struct spt_node **slot, int level, uint64_t base,
+		uint64_t lo, uint64_t hi) {
+	struct spt_node *node = *slot;
+	int shift = SPT_BITS * (SPT_LEVELS - 1 - level);
+	size_t removed = 0;
+	size_t i;
+
+	for (i = 0; i < SPT_FANOUT && node->cnt > 0; i++) {
+		uint64_t first = base + ((uint64_t) i << shift);
+		uint64_t last = first + ((uint64_t) 1 << shift);
+
+		if (node->slots[i] == NULL || last <= lo || first >= hi)
+			continue;
+		if (level == SPT_LEVELS - 1) {
+			vm_dealloc_page (node->slots[i]);
+			node->slots[i] = NULL;
+			node->cnt--;
+			removed++;
+		} else {
+			removed += spt_clear ((struct spt_node **) &node->slots[i],
+					level + 1, first, lo, hi);
+			if (node->slots[i] == NULL)
+				node->cnt--;
+		}
+	}
+
+	if (node->cnt == 0) {
+		kmem_cache_free (&spt_node_cache, node);
+		*slot = NULL;
+	}
+	return removed;
+}
+
+/* Removes the pages from START up to END, both page-aligned,
+ * from SPT and deallocates them.  Untouched parts of the tree are
+ * skipped, so this takes time in proportion to the pages present,
+ * not the length of the range. */
+void
+spt_remove_range (struct supplemental_page_table *spt, void *start, void *end) {
+	ASSERT (pg_ofs (start) == 0 && pg_ofs (end) == 0);
+
+	if (spt->root != NULL && start < end)
+		spt->page_cnt -= spt_clear (&spt->root, 0, 0,
+				pg_no (start), pg_no (end));
+}
+
+/* Calls FUNC with AUX on each page under NODE, a node at LEVEL, in
+ * order of address, for as long as FUNC returns true.  Returns
+ * false if FUNC did. */
+static bool
+spt_for_each (struct spt_node *node, int level,
+		bool (*func) (struct page *, void *aux), void *aux) {
+	size_t i;
+
+	for (i = 0; i < SPT_FANOUT; i++) {
+		if (node->slots[i] == NULL)
+			continue;
+		if (level == SPT_LEVELS - 1) {
+			if (!func (node->slots[i], aux))
+				return false;
+		} else if (!spt_for_each (node->slots[i], level + 1, func, aux))
+			return false;
+	}
+	return true;
+}
+
+/* Returns true if evicting the page in FRAME would cost a write:
+ * if it was changed since it was last saved, or it is an anonymous
+ * page with no copy in swap.  Anonymous pages are filled through
+ * their kernel addresses, which leaves their dirty bits clear, so
+ * the bit alone does not tell.  frame_lock must be held, and FRAME
+ * must have a page. */
+static bool
+frame_needs_write (struct frame *frame) {
+	struct page *page = frame->page;
+
+	return pml4_is_dirty (frame->pml4, page->va)
+		|| (VM_TYPE (page->operations->type) == VM_ANON
+			&& page->anon.slot == SWAP_NONE);
+}
+
+/* Clock: the hand sweeps the frame table.  A page accessed since
+ * the hand last passed it gets a second chance: its accessed bit
+ * is cleared and the hand moves on.  Of the rest, a clean page is
+ * taken at once, since evicting it costs no write (see
+ * frame_needs_write()).  A dirty one is taken only if a full turn
+ * of the hand finds no clean page. */
+
+static size_t clock_hand;               /* Next frame to look at. */
+
+static void
+clock_init (void) {
+	clock_hand = 0;
+}
+
+static void
+clock_nop (struct frame *frame UNUSED) {
+}
+
+static void
+clock_forget (uint64_t *pml4 UNUSED) {
+}
+
+static struct frame *
+clock_victim (void) {
+	struct frame *dirty = NULL;
+	size_t i;
+
+	for (i = 0; i < 2 * frame_cnt; i++) {
+		struct frame *f = &frames[clock_hand];
+
+		if (i == frame_cnt && dirty != NULL)
+			break;
+		clock_hand = (clock_hand + 1) % frame_cnt;
+		frame_stats.scans++;
+
+		if (f->page == NULL || f->pinned)
+			continue;
+		if (pml4_is_accessed (f->pml4, f->page->va))
+			pml4_set_accessed (f->pml4, f->page->va, false);
+		else if (!frame_needs_write (f))
+			return f;
+		else if (dirty == NULL)
+			dirty = f;
+	}
+	return dirty;
+}
+
+static const struct evict_policy clock_policy = {
+	.name = "clock",
+	.init = clock_init,
+	.admit = clock_nop,
+	.release = clock_nop,
+	.victim = clock_victim,
+	.evicted = clock_nop,
+	.spared = clock_nop,
+	.forget = clock_forget,
+};
+
+/* 2Q, after Johnson and Shasha, "2Q: A Low Overhead High
+ * Performance Buffer Management Replacement Algorithm" (VLDB '94).
+ *
+ * A page brought in goes on a1in, a FIFO, and is evicted from
+ * there in order, however often it is used meanwhile.  Evicting a
+ * page from a1in leaves a ghost of it, just its address, on a1out,
+ * a FIFO of the last TWOQ_KOUT such ghosts.  A page brought back
+ * while its ghost is on a1out has proven itself, and goes on am
+ * instead, where it is managed by clock as above.  Pages are taken
+ * from a1in while it is over TWOQ_KIN, otherwise from am.
+ *
+ * A sweep through memory that is larger than RAM, touching each
+ * page once, thus only ever cycles through a1in, and the hot pages
+ * on am survive it, where plain clock would let the sweep push
+ * them out. */
+
+#define TWOQ_KIN(FRAMES) ((FRAMES) / 4 + 1)     /* Target a1in size. */
+#define TWOQ_KOUT(FRAMES) ((FRAMES) / 2 + 1)    /* a1out size. */
+
+/* A page evicted from a1in, remembered on a1out. */
+struct ghost {
+	uint64_t *pml4;                 /* Page table that mapped it. */
+	void *va;                       /* Its address, or null if unused. */
+	struct hash_elem elem;          /* In twoq_ghosts. */
+};
+
+static struct list twoq_a1in;           /* Pages seen once, oldest first. */
+static struct list twoq_am;             /* Hot pages; front is the hand. */
+static size_t twoq_a1in_cnt, twoq_am_cnt;
+static size_t twoq_kin;
+
+static struct ghost *twoq_a1out;        /* Ring of TWOQ_KOUT ghosts. */
+static size_t twoq_kout, twoq_a1out_next;
+static struct hash twoq_ghosts;         /* The ghosts on a1out. */
+
+static uint64_t
+ghost_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct ghost *g = hash_entry (e, struct ghost, elem);
+
+	return hash_bytes (&g->pml4, sizeof g->pml4) ^ hash_int (pg_no (g->va));
+}
+
+static bool
+ghost_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct ghost *a = hash_entry (a_, struct ghost, elem);
+	const struct ghost *b = hash_entry (b_, struct ghost, elem);
+
+	return a->pml4 != b->pml4 ? a->pml4 < b->pml4 : a->va < b->va;
+}
+
+static void
+twoq_init (void) {
+	list_init (&twoq_a1in);
+	list_init (&twoq_am);
+	twoq_a1in_cnt = twoq_am_cnt = 0;
+	twoq_kin = TWOQ_KIN (frame_cnt);
+	twoq_kout = TWOQ_KOUT (frame_cnt);
+	twoq_a1out = vcalloc (twoq_kout, sizeof *twoq_a1out);
+	twoq_a1out_next = 0;
+	if (twoq_a1out == NULL
+			|| !hash_init (&twoq_ghosts, ghost_hash, ghost_less, NULL))
+		PANIC ("vm: no memory for 2Q's %zu ghosts", twoq_kout);
+}
+
+/* Puts FRAME on am or, if HOT is false, on a1in. */
+static void
+twoq_push (struct frame *frame, bool hot) {
+	frame->hot = hot;
+	if (hot) {
+		list_push_back (&twoq_am, &frame->elem);
+		twoq_am_cnt++;
+	} else {
+		list_push_back (&twoq_a1in, &frame->elem);
+		twoq_a1in_cnt++;
+	}
+}
+
+/* If the page in FRAME has a ghost on a1out, removes the ghost and
+ * returns true. */
+static bool
+twoq_take_ghost (struct frame *frame) {
+	struct ghost key = { .pml4 = frame->pml4, .va = frame->page->va };
+	struct hash_elem *e = hash_find (&twoq_ghosts, &key.elem);
+
+	if (e == NULL)
+		return false;
+	hash_delete (&twoq_ghosts, e);
+	hash_entry (e, struct ghost, elem)->va = NULL;
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+static void
+twoq_admit (struct frame *frame) {
+	twoq_push (frame, twoq_take_ghost (frame));
+}
+
+static void
+twoq_release (struct frame *frame) {
+	list_remove (&frame->elem);
+	if (frame->hot)
+		twoq_am_cnt--;
+	else
+		twoq_a1in_cnt--;
+}
+
+/* Returns the oldest unpinned frame on a1in, or a null pointer if
+ * there is none. */
 static struct frame *
-vm_get_victim (void) {
+twoq_a1in_victim (void) {
+	struct list_elem *e;
+
+	for (e = list_begin (&twoq_a1in); e != list_end (&twoq_a1in);
+			e = list_next (e)) {
+		struct frame *f = list_entry (e, struct frame, elem);
+
+		frame_stats.scans++;
+		if (!f->pinned)
+			return f;
+	}
+	return NULL;
+}
+
+/* Runs clock over am, whose front is the hand, and returns the
+ * frame picked, or a null pointer if all are pinned. */
+static struct frame *
+twoq_am_victim (void) {
+	struct frame *dirty = NULL;
+	size_t i;
+
+	for (i = 0; i < 2 * twoq_am_cnt; i++) {
+		struct frame *f = list_entry (list_front (&twoq_am),
+				struct frame, elem);
+
+		if (i == twoq_am_cnt && dirty != NULL)
+			break;
+		list_push_back (&twoq_am, list_pop_front (&twoq_am));
+		frame_stats.scans++;
+
+		if (f->pinned)
+			continue;
+		if (pml4_is_accessed (f->pml4, f->page->va))
+			pml4_set_accessed (f->pml4, f->page->va, false);
+		else if (!frame_needs_write (f))
+			return f;
+		else if (dirty == NULL)
+			dirty = f;
+	}
+	return dirty;
+}
+
+static struct frame *
+twoq_victim (void) {
 	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
 
+	if (twoq_a1in_cnt > twoq_kin || twoq_am_cnt == 0)
+		victim = twoq_a1in_victim ();
+	if (victim == NULL)
+		victim = twoq_am_victim ();
+	if (victim == NULL)
+		victim = twoq_a1in_victim ();
 	return victim;
 }
 
-/* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+/* Leaves a ghost of FRAME's page on a1out if it came from a1in. */
+static void
+twoq_evicted (struct frame *frame) {
+	if (!frame->hot) {
+		struct ghost *g = &twoq_a1out[twoq_a1out_next];
+
+		twoq_a1out_next = (twoq_a1out_next + 1) % twoq_kout;
+		if (g->va != NULL)
+			hash_delete (&twoq_ghosts, &g->elem);
+		g->pml4 = frame->pml4;
+		g->va = frame->page->va;
+		if (hash_insert (&twoq_ghosts, &g->elem) != NULL)
+			g->va = NULL;
+	}
+	twoq_release (frame);
+}
+
+/* A page that cannot be evicted is as good as hot. */
+static void
+twoq_spared (struct frame *frame) {
+	twoq_release (frame);
+	twoq_push (frame, true);
+}
+
+/* Removes the ghosts of PML4's pages.  A later process may get a
+ * page table at the same address, and its pages must not pass for
+ * ones seen before. */
+static void
+twoq_forget (uint64_t *pml4) {
+	size_t i;
+
+	for (i = 0; i < twoq_kout; i++) {
+		struct ghost *g = &twoq_a1out[i];
+
+		if (g->va != NULL && g->pml4 == pml4) {
+			hash_delete (&twoq_ghosts, &g->elem);
+			g->va = NULL;
+		}
+	}
+}
+
+static const struct evict_policy twoq_policy = {
+	.name = "2q",
+	.init = twoq_init,
+	.admit = twoq_admit,
+	.release = twoq_release,
+	.victim = twoq_victim,
+	.evicted = twoq_evicted,
+	.spared = twoq_spared,
+	.forget = twoq_forget,
+};
+
+/* Get the struct frame, that will be evicted, as chosen by the
+ * replacement policy.  frame_lock must be held.  Returns a null
+ * pointer if every frame is free or pinned. */
+static struct frame *
+vm_get_victim (void) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	return evict_policy->victim ();
+}
+
+/* Returns the frame holding the page at VA in the address space
+ * of VICTIM, an anonymous page being evicted, if that page could
+ * go out to swap in the same write: if it is an anonymous page in
+ * a frame, mapped, neither pinned nor accessed, and not already in
+ * swap as it is.  Otherwise returns a null pointer.  frame_lock
+ * must be held. */
+static struct frame *
+vm_cluster_frame (struct frame *victim, void *va) {
+	uint8_t *kva;
+	struct frame *f;
+
+	if (!is_user_vaddr (va))
+		return NULL;
+	kva = pml4_get_page (victim->pml4, va);
+	if (kva < frame_base || kva >= frame_base + frame_cnt * PGSIZE)
+		return NULL;
+
+	f = frame_of (kva);
+	if (f->page == NULL || f->pinned || f->pml4 != victim->pml4
+			|| f->page->va != va
+			|| VM_TYPE (f->page->operations->type) != VM_ANON
+			|| pml4_is_accessed (f->pml4, va)
+			|| !frame_needs_write (f))
+		return NULL;
+	return f;
+}
+
+/* Fills BATCH[], whose first element is VICTIM, with VICTIM and,
+ * if it is an anonymous page that must be written, the frames
+ * of as many of its neighbours as vm_cluster_frame() allows, up
+ * to SWAP_CLUSTER in all, so that they go out together.  Up to
+ * half may come from below VICTIM, since a fault reads ahead
+ * only upward.  Pins the neighbours' frames.  Returns the number
+ * of frames in BATCH[], which are in order of address.  frame_lock
+ * must be held. */
+static size_t
+vm_gather_cluster (struct frame *batch[SWAP_CLUSTER]) {
+	struct frame *victim = batch[0];
+	struct page *page = victim->page;
+	size_t cnt = 1, below, i;
+	uint8_t *va;
+
+	if (VM_TYPE (page->operations->type) != VM_ANON
+			|| !frame_needs_write (victim))
+		return 1;
+
+	for (va = (uint8_t *) page->va - PGSIZE; cnt < SWAP_CLUSTER / 2;
+			va -= PGSIZE) {
+		struct frame *f = vm_cluster_frame (victim, va);
+
+		if (f == NULL)
+			break;
+		f->pinned = true;
+		batch[cnt++] = f;
+	}
+	below = cnt - 1;
+	for (va = (uint8_t *) page->va + PGSIZE; cnt < SWAP_CLUSTER;
+			va += PGSIZE) {
+		struct frame *f = vm_cluster_frame (victim, va);
+
+		if (f == NULL)
+			break;
+		f->pinned = true;
+		batch[cnt++] = f;
+	}
+
+	/* BATCH[0...BELOW] runs down from VICTIM.  Reverse it. */
+	for (i = 0; i < below - i; i++) {
+		struct frame *t = batch[i];
+
+		batch[i] = batch[below - i];
+		batch[below - i] = t;
+	}
+	return cnt;
+}
+
+/* Evict one page and return the corresponding frame, pinned and
+ * with no page.  An anonymous victim takes its neighbours with it
+ * to swap, in one write (see vm_gather_cluster()), and their
+ * frames go back to the user pool, which saves faults on the way
+ * to evicting them one at a time.  A victim that cannot be swapped
+ * out is mapped again, as if just accessed, and the next one
+ * tried.  frame_lock is dropped for the write, so that other
+ * faults and evictions go on meanwhile.  Return NULL on error: if
+ * no page could be evicted. */
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+	struct frame *victim = NULL;
+	size_t tries;
 
-	return NULL;
+	lock_acquire (&frame_lock);
+	for (tries = 0; tries < frame_cnt && victim == NULL; tries++) {
+		struct frame *batch[SWAP_CLUSTER];
+		struct page *pages[SWAP_CLUSTER];
+		bool dirty[SWAP_CLUSTER], write[SWAP_CLUSTER];
+		size_t cnt, i;
+		bool ok;
+
+		victim = vm_get_victim ();
+		if (victim == NULL)
+			break;
+		victim->pinned = true;
+		batch[0] = victim;
+		cnt = vm_gather_cluster (batch);
+
+		/* Unmap the pages on every CPU before saving them, so that
+		 * their owner cannot change them behind our back. */
+		for (i = 0; i < cnt; i++) {
+			pages[i] = batch[i]->page;
+			batch[i]->writing = true;
+			pml4_clear_page (batch[i]->pml4, pages[i]->va);
+		}
+		smp_flush_tlb ();
+		for (i = 0; i < cnt; i++) {
+			dirty[i] = pml4_is_dirty (batch[i]->pml4, pages[i]->va);
+			write[i] = frame_needs_write (batch[i]);
+		}
+
+		lock_release (&frame_lock);
+		ok = cnt == 1 ? swap_out (pages[0])
+			: anon_swap_out_cluster (pages, cnt);
+		lock_acquire (&frame_lock);
+
+		for (i = 0; i < cnt; i++) {
+			struct frame *f = batch[i];
+
+			vm_end_write (f);
+			if (!ok) {
+				pml4_set_page (f->pml4, pages[i]->va, f->kva,
+						pages[i]->writable);
+				pml4_set_accessed (f->pml4, pages[i]->va, true);
+				pml4_set_dirty (f->pml4, pages[i]->va, dirty[i]);
+				evict_policy->spared (f);
+				f->pinned = false;
+				continue;
+			}
+
+			evict_policy->evicted (f);
+			pages[i]->frame = NULL;
+			f->page = NULL;
+			f->pml4 = NULL;
+			frame_stats.used_cnt--;
+			frame_stats.evictions++;
+			if (write[i])
+				frame_stats.writebacks++;
+			if (f != victim) {
+				f->pinned = false;
+				palloc_free_page (f->kva);
+			}
+		}
+		if (!ok)
+			victim = NULL;
+	}
+	lock_release (&frame_lock);
+	return victim;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * and return it.  Either way, the frame is pinned and has no page.
+ * Returns a null pointer only if the user pool is full and no page
+ * could be evicted. */
 static struct frame *
 vm_get_frame (void) {
-	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+	void *kva = palloc_get_page (PAL_USER);
+	struct frame *frame;
 
-	ASSERT (frame != NULL);
+	if (kva == NULL)
+		return vm_evict_frame ();
+
+	frame = frame_of (kva);
+	lock_acquire (&frame_lock);
 	ASSERT (frame->page == NULL);
+	frame->pinned = true;
+	lock_release (&frame_lock);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Returns FRAME, which must be pinned and have no page, to the
+ * user pool. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+vm_put_frame (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	ASSERT (frame->pinned && frame->page == NULL);
+	frame->pinned = false;
+	lock_release (&frame_lock);
+	palloc_free_page (frame->kva);
+}
+
+/* Like vm_get_frame(), but only takes a free frame, never
+ * evicting a page for it.  Returns a null pointer if there is no
+ * free frame. */
+struct frame *
+vm_get_free_frame (void) {
+	void *kva = palloc_get_page (PAL_USER);
+	struct frame *frame;
+
+	if (kva == NULL)
+		return NULL;
+	frame = frame_of (kva);
+	lock_acquire (&frame_lock);
+	ASSERT (frame->page == NULL);
+	frame->pinned = true;
+	lock_release (&frame_lock);
+	return frame;
+}
+
+/* Makes FRAME, from vm_get_free_frame() and holding the contents
+ * of PAGE, the running process's, PAGE's frame, without mapping
+ * PAGE.  Its first touch will fault and map it.  For reading
+ * ahead. */
+void
+vm_install_frame (struct page *page, struct frame *frame) {
+	uint64_t *pml4 = thread_current ()->pml4;
+
+	lock_acquire (&frame_lock);
+	ASSERT (frame->pinned && frame->page == NULL);
+	ASSERT (page->frame == NULL);
+	frame->page = page;
+	frame->pml4 = pml4;
+	page->frame = frame;
+	evict_policy->admit (frame);
+	frame_stats.used_cnt++;
+	frame_stats.page_ins++;
+
+	/* Drop the bits left over from PAGE's last mapping, so that the
+	 * policy sees a page not yet used. */
+	pml4_set_accessed (pml4, page->va, false);
+	pml4_set_dirty (pml4, page->va, false);
+	frame->pinned = false;
+	lock_release (&frame_lock);
+}
+
+/* Growing the stack, down to the page containing ADDR. */
+static void
+vm_stack_growth (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *stack = vma_find (spt, (uint8_t *) USER_STACK - 1);
+
+	if (stack != NULL && (stack->type & VM_STACK))
+		vma_grow_down (spt, stack, pg_round_down (addr));
 }
 
 /* Handle the fault on write_protected page */
@@ -128,15 +921,44 @@ static bool
 vm_handle_wp (struct page *page UNUSED) {
 }
 
+/* Returns the running process's page at VA.  If VA is in a VMA
+ * but has not been touched yet, creates the page.  Returns a null
+ * pointer if VA is in no VMA or memory is short. */
+static struct page *
+vm_get_page (void *va) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *page = spt_find_page (spt, pg_round_down (va));
+
+	if (page == NULL) {
+		struct vma *vma = vma_find (spt, va);
+
+		if (vma != NULL)
+			page = vma_alloc_page (vma, pg_round_down (va));
+	}
+	return page;
+}
+
 /* Return true on success */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
-	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	struct page *page;
 
+	if (addr == NULL || !not_present || !is_user_vaddr (addr))
+		return false;
+
+	page = vm_get_page (addr);
+	if (page == NULL && user
+			&& addr >= (void *) (USER_STACK - STACK_MAX)
+			&& addr < (void *) USER_STACK
+			&& (uint8_t *) addr >= (uint8_t *) f->rsp - 8) {
+		/* A push, or an access above the stack pointer, just below
+		 * the stack. */
+		vm_stack_growth (addr);
+		page = vm_get_page (addr);
+	}
+	if (page == NULL || (write && !page->writable))
+		return false;
 	return vm_do_claim_page (page);
 }
 
@@ -148,43 +970,257 @@ vm_dealloc_page (struct page *page) {
 	free (page);
 }
 
+/* Unmaps PAGE, which must be the running process's, and frees
+ * its frame, if it has one.  If WRITE_BACK, the page is swapped
+ * out first, for a file-backed page that must reach its file, with
+ * frame_lock dropped.  For the destroy operations.  Waits for an
+ * eviction of PAGE that is under way, which may leave PAGE with no
+ * frame. */
+void
+vm_free_frame (struct page *page, bool write_back) {
+	struct frame *frame;
+
+	lock_acquire (&frame_lock);
+	frame = vm_wait_frame (page);
+	if (frame == NULL) {
+		lock_release (&frame_lock);
+		return;
+	}
+	ASSERT (frame->page == page && !frame->pinned);
+	if (write_back) {
+		frame->pinned = frame->writing = true;
+		lock_release (&frame_lock);
+		swap_out (page);
+		lock_acquire (&frame_lock);
+		vm_end_write (frame);
+		frame->pinned = false;
+	}
+	pml4_clear_page (frame->pml4, page->va);
+	evict_policy->release (frame);
+	page->frame = NULL;
+	frame->page = NULL;
+	frame->pml4 = NULL;
+	frame_stats.used_cnt--;
+	lock_release (&frame_lock);
+	palloc_free_page (frame->kva);
+}
+
+/* Returns PAGE's frame, or a null pointer if PAGE is not in
+ * memory.  If PAGE is being written out, first waits on its frame
+ * until the write is over, after which PAGE may have no frame.
+ * frame_lock must be held. */
+static struct frame *
+vm_wait_frame (struct page *page) {
+	struct frame *frame;
+
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+
+	while ((frame = page->frame) != NULL && frame->writing)
+		cond_wait (&frame->written, &frame_lock);
+	return frame;
+}
+
+/* Marks the write of FRAME's page as over and wakes up those
+ * waiting for it in vm_wait_frame().  frame_lock must be held. */
+static void
+vm_end_write (struct frame *frame) {
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+	ASSERT (frame->writing);
+
+	frame->writing = false;
+	cond_broadcast (&frame->written, &frame_lock);
+}
+
+/* Stores a snapshot of the frame table's statistics in *STATS. */
+void
+vm_get_frame_stats (struct frame_stats *stats) {
+	lock_acquire (&frame_lock);
+	*stats = frame_stats;
+	lock_release (&frame_lock);
+}
+
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	struct page *page = vm_get_page (va);
 
-	return vm_do_claim_page (page);
+	return page != NULL && vm_do_claim_page (page);
 }
 
-/* Claim the PAGE and set up the mmu. */
-static bool
-vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+/* Claims PAGE, like vm_do_claim_page(), but leaves its frame
+ * pinned, so that the caller may use the frame until it calls
+ * vm_unpin().  Returns the frame, or a null pointer on failure. */
+static struct frame *
+vm_claim_pinned (struct page *page) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	struct frame *frame;
+
+	/* If PAGE is being evicted, this waits until it is out. */
+	lock_acquire (&frame_lock);
+	frame = vm_wait_frame (page);
+	if (frame != NULL)
+		frame->pinned = true;
+	lock_release (&frame_lock);
+	if (frame != NULL) {
+		/* PAGE was read ahead, or an eviction of it failed and
+		 * mapped it again. */
+		if (pml4_get_page (pml4, page->va) == NULL) {
+			if (!pml4_set_page (pml4, page->va, frame->kva, page->writable)) {
+				vm_unpin (frame);
+				return NULL;
+			}
+			if (VM_TYPE (page->operations->type) == VM_ANON)
+				anon_readahead_hit (page);
+		}
+		return frame;
+	}
+
+	/* No one else brings PAGE in, so it stays out meanwhile. */
+	frame = vm_get_frame ();
+	if (frame == NULL)
+		return NULL;
 
-	/* Set links */
+	/* Set links. */
+	lock_acquire (&frame_lock);
+	ASSERT (page->frame == NULL);
 	frame->page = page;
+	frame->pml4 = pml4;
 	page->frame = frame;
+	evict_policy->admit (frame);
+	frame_stats.used_cnt++;
+	frame_stats.page_ins++;
+	lock_release (&frame_lock);
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+	/* Map the page only once its contents are in. */
+	if (!swap_in (page, frame->kva)
+			|| !pml4_set_page (pml4, page->va, frame->kva, page->writable)) {
+		lock_acquire (&frame_lock);
+		evict_policy->release (frame);
+		page->frame = NULL;
+		frame->page = NULL;
+		frame->pml4 = NULL;
+		frame_stats.used_cnt--;
+		lock_release (&frame_lock);
+		vm_put_frame (frame);
+		return NULL;
+	}
+	return frame;
+}
+
+/* Makes FRAME, pinned by vm_claim_pinned() or copy_page(), a
+ * candidate for eviction again. */
+static void
+vm_unpin (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	ASSERT (frame->pinned);
+	frame->pinned = false;
+	lock_release (&frame_lock);
+}
+
+/* Claim the PAGE and set up the mmu. */
+static bool
+vm_do_claim_page (struct page *page) {
+	struct frame *frame = vm_claim_pinned (page);
 
-	return swap_in (page, frame->kva);
+	if (frame == NULL)
+		return false;
+	vm_unpin (frame);
+	return true;
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	spt->root = NULL;
+	spt->page_cnt = 0;
+	vma_tree_init (spt);
 }
 
-/* Copy supplemental page table from src to dst */
+/* Adds a copy of SRC, a page of the parent process, to the running
+ * process's supplemental page table, whose VMAs must already have
+ * been copied.  A page that was never loaded is left for the child
+ * to create from its own VMA, or if it is in none, copied as is,
+ * sharing its initializer's AUX with the parent.  So is a
+ * file-backed page that was evicted, and so written back.  A
+ * loaded page is loaded in the child too, with the parent's
+ * contents, from memory or, if the parent's copy was swapped out,
+ * from swap. */
+static bool
+copy_page (struct page *src, void *aux UNUSED) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	enum vm_type type = page_get_type (src);
+	struct vma *vma = vma_find (spt, src->va);
+	struct frame *src_frame, *dst_frame;
+	struct page *dst;
+	bool ok;
+
+	if (VM_TYPE (src->operations->type) == VM_UNINIT)
+		return vma != NULL
+			|| vm_alloc_page_with_initializer (src->uninit.type, src->va,
+					src->writable, src->uninit.init, src->uninit.aux);
+
+	/* Keep the parent's page where it is until it is copied.  One
+	 * that is out stays out, since the parent is waiting for us. */
+	lock_acquire (&frame_lock);
+	src_frame = vm_wait_frame (src);
+	if (src_frame != NULL)
+		src_frame->pinned = true;
+	lock_release (&frame_lock);
+	if (src_frame == NULL && type == VM_FILE)
+		return vma != NULL;
+
+	if (vma != NULL)
+		dst = vma_alloc_page (vma, src->va);
+	else if (vm_alloc_page (type, src->va, src->writable))
+		dst = spt_find_page (spt, src->va);
+	else
+		dst = NULL;
+	dst_frame = dst != NULL ? vm_claim_pinned (dst) : NULL;
+	ok = dst_frame != NULL;
+	if (ok) {
+		if (src_frame != NULL)
+			memcpy (dst_frame->kva, src_frame->kva, PGSIZE);
+		else
+			ok = anon_swap_copy (src, dst_frame->kva);
+		pml4_set_dirty (dst_frame->pml4, dst->va, true);
+		vm_unpin (dst_frame);
+	}
+	if (src_frame != NULL)
+		vm_unpin (src_frame);
+	return ok;
+}
+
+/* Copy supplemental page table from src to dst.  DST must be the
+ * running thread's, and empty. */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	ASSERT (dst == &thread_current ()->spt);
+	ASSERT (dst->root == NULL);
+
+	if (!vma_copy (dst, src))
+		return false;
+	return src->root == NULL || spt_for_each (src->root, 0, copy_page, NULL);
 }
 
-/* Free the resource hold by the supplemental page table */
+/* Free the resource hold by the supplemental page table.  SPT
+ * must be the running thread's. */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	uint64_t *pml4 = thread_current ()->pml4;
+
+	ASSERT (spt == &thread_current ()->spt);
+
+	/* VMAs first, so that file-backed pages can still be written
+	 * back to their files. */
+	vma_tree_kill (spt);
+	spt_remove_range (spt, NULL, (void *) pg_round_down (KERN_BASE));
+	ASSERT (spt->root == NULL && spt->page_cnt == 0);
+
+	/* The page table is about to be freed. */
+	if (pml4 != NULL) {
+		lock_acquire (&frame_lock);
+		evict_policy->forget (pml4);
+		lock_release (&frame_lock);
+	}
 }
@@ -0,0 +1,214 @@
+/* vma.c: Virtual memory areas.
+ *
+ * Each process's VMAs are kept in a red-black tree in its
+ * supplemental page table, ordered by start address.  VMAs never
+ * overlap, so the one containing an address, if any, is the one
+ * with the greatest start at or below it, and a range is free if
+ * the VMA with the greatest start below its end ends before its
+ * start.  Both are a single O(log n) descent. */
+
+#include "vm/vma.h"
+#include <round.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+static struct kmem_cache vma_cache;
+
+static bool vma_load_page (struct page *, void *aux);
+
+/* Initializes the VMA allocator. */
+void
+vma_init (void) {
+	kmem_cache_init (&vma_cache, "vma", sizeof (struct vma), NULL);
+}
+
+/* Orders VMAs by start address. */
+static bool
+vma_less (const struct rbtree_elem *a_, const struct rbtree_elem *b_,
+		void *aux UNUSED) {
+	const struct vma *a = rbtree_entry (a_, struct vma, elem);
+	const struct vma *b = rbtree_entry (b_, struct vma, elem);
+
+	return a->start < b->start;
+}
+
+/* Initializes SPT's VMAs as empty. */
+void
+vma_tree_init (struct supplemental_page_table *spt) {
+	rbtree_init (&spt->vmas, vma_less, NULL);
+}
+
+/* Returns the VMA in SPT with the greatest start at or below VA,
+ * or a null pointer if there is none. */
+static struct vma *
+vma_floor (struct supplemental_page_table *spt, const void *va) {
+	struct vma key = { .start = (void *) va };
+	struct rbtree_elem *e;
+
+	e = rbtree_floor (&spt->vmas, &key.elem);
+	return e != NULL ? rbtree_entry (e, struct vma, elem) : NULL;
+}
+
+/* Returns the VMA in SPT that contains VA, or a null pointer if
+ * VA is in none. */
+struct vma *
+vma_find (struct supplemental_page_table *spt, const void *va) {
+	struct vma *vma = vma_floor (spt, va);
+
+	return vma != NULL && va < vma->end ? vma : NULL;
+}
+
+/* Returns true if some VMA in SPT overlaps START...END. */
+static bool
+vma_overlaps (struct supplemental_page_table *spt,
+		const void *start, const void *end) {
+	struct vma *vma = vma_floor (spt, (const uint8_t *) end - 1);
+
+	return vma != NULL && vma->end > start;
+}
+
+/* Adds a VMA of TYPE to SPT covering LENGTH bytes, rounded up to
+ * whole pages, at START, which must be page-aligned.  Its first
+ * READ_BYTES bytes come from FILE starting at OFFSET, and the
+ * rest are zero.  FILE may be null if READ_BYTES is 0.  The VMA
+ * keeps its own reopened FILE, so the caller may close its copy.
+ *
+ * Returns the new VMA, or a null pointer if the range is empty,
+ * reaches outside user space or overlaps another VMA, or if
+ * memory is short.  No pages are created until they are
+ * touched. */
+struct vma *
+vma_map (struct supplemental_page_table *spt, void *start, size_t length,
+		enum vm_type type, bool writable, struct file *file, off_t offset,
+		size_t read_bytes) {
+	uint8_t *end = (uint8_t *) start + ROUND_UP (length, PGSIZE);
+	struct vma *vma;
+
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT (read_bytes <= length);
+	ASSERT (file != NULL || read_bytes == 0);
+
+	if (start == NULL || length == 0 || end <= (uint8_t *) start
+			|| (uint64_t) end > KERN_BASE || vma_overlaps (spt, start, end))
+		return NULL;
+
+	vma = kmem_cache_alloc (&vma_cache);
+	if (vma == NULL)
+		return NULL;
+	vma->start = start;
+	vma->end = end;
+	vma->type = type;
+	vma->writable = writable;
+	vma->file = NULL;
+	vma->offset = offset;
+	vma->read_bytes = read_bytes;
+	if (file != NULL) {
+		vma->file = file_reopen (file);
+		if (vma->file == NULL) {
+			kmem_cache_free (&vma_cache, vma);
+			return NULL;
+		}
+	}
+
+	/* Cannot collide, since it overlaps nothing. */
+	rbtree_insert (&spt->vmas, &vma->elem);
+	return vma;
+}
+
+/* Removes VMA, and the pages created in it, from SPT. */
+void
+vma_unmap (struct supplemental_page_table *spt, struct vma *vma) {
+	spt_remove_range (spt, vma->start, vma->end);
+	rbtree_remove (&spt->vmas, &vma->elem);
+	file_close (vma->file);
+	kmem_cache_free (&vma_cache, vma);
+}
+
+/* Extends VMA in SPT, which must have no file data, down to
+ * START, which must be page-aligned.  Returns false if another
+ * VMA is in the way.  VMA keeps its place in the tree, since no
+ * other VMA starts between its old and new start. */
+bool
+vma_grow_down (struct supplemental_page_table *spt, struct vma *vma,
+		void *start) {
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT (vma->read_bytes == 0);
+
+	if (start >= vma->start)
+		return true;
+	if (start == NULL || vma_overlaps (spt, start, vma->start))
+		return false;
+	vma->start = start;
+	return true;
+}
+
+/* Creates the page at UPAGE in VMA, which must be one of the
+ * running process's, to be loaded from VMA when it is claimed.
+ * Returns the page, or a null pointer if memory is short. */
+struct page *
+vma_alloc_page (struct vma *vma, void *upage) {
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (upage >= vma->start && upage < vma->end);
+
+	if (!vm_alloc_page_with_initializer (vma->type, upage, vma->writable,
+				vma_load_page, vma))
+		return NULL;
+	return spt_find_page (&thread_current ()->spt, upage);
+}
+
+/* Fills PAGE, which is being claimed for the first time, from its
+ * VMA AUX: with file data as far as the VMA has any, then zeros.
+ * A file-backed page also learns where in the file it belongs. */
+static bool
+vma_load_page (struct page *page, void *aux) {
+	struct vma *vma = aux;
+	uint8_t *kva = page->frame->kva;
+	size_t ofs = (uint8_t *) page->va - (uint8_t *) vma->start;
+	size_t read_bytes = ofs < vma->read_bytes ? vma->read_bytes - ofs : 0;
+
+	if (read_bytes > PGSIZE)
+		read_bytes = PGSIZE;
+	if (VM_TYPE (vma->type) == VM_FILE) {
+		page->file.file = vma->file;
+		page->file.offset = vma->offset + ofs;
+		page->file.read_bytes = read_bytes;
+	}
+
+	if (read_bytes > 0 && file_read_at (vma->file, kva, read_bytes,
+				vma->offset + ofs) != (off_t) read_bytes)
+		return false;
+	memset (kva + read_bytes, 0, PGSIZE - read_bytes);
+	return true;
+}
+
+/* Gives DST, which must have no VMAs, a copy of each of SRC's
+ * VMAs. */
+bool
+vma_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct rbtree_elem *e;
+
+	ASSERT (rbtree_empty (&dst->vmas));
+
+	for (e = rbtree_min (&src->vmas); e != NULL; e = rbtree_next (e)) {
+		struct vma *vma = rbtree_entry (e, struct vma, elem);
+
+		if (vma_map (dst, vma->start,
+					(uint8_t *) vma->end - (uint8_t *) vma->start, vma->type,
+					vma->writable, vma->file, vma->offset,
+					vma->read_bytes) == NULL)
+			return false;
+	}
+	return true;
+}
+
+/* Removes all of SPT's VMAs and the pages created in them. */
+void
+vma_tree_kill (struct supplemental_page_table *spt) {
+	while (!rbtree_empty (&spt->vmas))
+		vma_unmap (spt, rbtree_entry (spt->vmas.root, struct vma, elem));
+}